@@ -0,0 +1,22 @@
+#version 330 core
+
+// First full screen pass of deferred lighting, writes the light meshes
+// and clears lit surfaces to black for the light volumes to add onto
+
+out vec4 outPixel;
+
+uniform sampler2D gAlbedo;
+uniform sampler2D gDepth;
+uniform vec2 screenSize;
+
+void main(){
+    vec2 uv = gl_FragCoord.xy / screenSize;
+
+    // Nothing drawn here, keep the clear color
+    if (texture(gDepth, uv).r == 1.0) {
+        discard;
+    }
+
+    vec4 albedo = texture(gAlbedo, uv);
+    outPixel = albedo.a == 0.0 ? vec4(albedo.rgb, 1.0) : vec4(0.0, 0.0, 0.0, 1.0);
+}
@@ -0,0 +1,114 @@
+#version 330 core
+
+// Lighting pass of the deferred renderer, one draw per light covering its light volume.
+// Results are added together with blending
+
+out vec4 outPixel;
+
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+uniform vec2 screenSize;
+uniform mat4 invViewProj;   // Clip space back to world space
+
+uniform int light;          // Index into lightData
+uniform float radius;       // Distance past which the light adds less than 1/256
+
+// Struct to hold the light values, must match fragmentShader
+struct Light{
+    vec4 lightPos;
+    vec4 lightCol;
+    
+    float aStr;
+    float dStr;
+    float sStr;
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+// Per-frame values filled once by FrameUniforms, must match fragmentShader
+layout (std140) uniform Frame{
+    mat4 view;
+    mat4 projection;
+    vec4 cameraPos;         // Camera position in world space.
+    ivec4 clusterGrid;      // Light clusters along x, y, and z
+    vec4 clusterParams;     // Pixels per cluster across and up, depth slice scale and bias
+    ivec4 shadowLights;     // Light each shadow map belongs to, -1 if unused
+    vec4 shadowFar;         // Distance each shadow map reaches
+};
+
+// Same as fragmentShader, lights live in a texture buffer filled by LightClusters, 3 texels each
+uniform samplerBuffer lightData;
+
+Light fetchLight(int i){
+    vec4 a = texelFetch(lightData, 3 * i);
+    vec4 b = texelFetch(lightData, 3 * i + 1);
+    vec4 c = texelFetch(lightData, 3 * i + 2);
+    return Light(vec4(a.xyz, 1.0), vec4(b.xyz, 1.0), a.w, b.w, c.x, c.y, c.z, c.w);
+}
+
+// Same as fragmentShader, cube shadow maps (see ShadowMaps.h) storing distance from their light over shadowFar
+uniform samplerCubeShadow shadowMap0;
+uniform samplerCubeShadow shadowMap1;
+uniform samplerCubeShadow shadowMap2;
+
+float sampleShadow(samplerCubeShadow map, vec3 toPoint, float far){
+    float dist = length(toPoint);
+    if (dist >= far) {
+        return 1.0;
+    }
+    return texture(map, vec4(toPoint, (dist - 0.02) / far));
+}
+
+// How much of light l reaches pos past the shadow casters, 1 if it has no shadow map.
+// pos is pushed out along the normal a bit so surfaces don't shadow themselves
+float getShadow(int light, Light l, vec4 normal, vec4 pos){
+    vec3 toPoint = pos.xyz + normal.xyz * 0.02 - l.lightPos.xyz;
+    if (light == shadowLights.x) return sampleShadow(shadowMap0, toPoint, shadowFar.x);
+    if (light == shadowLights.y) return sampleShadow(shadowMap1, toPoint, shadowFar.y);
+    if (light == shadowLights.z) return sampleShadow(shadowMap2, toPoint, shadowFar.z);
+    return 1.0;
+}
+
+// Same as fragmentShader's getLight()
+vec4 getLight(Light l, vec4 normal, vec4 cDir, vec4 pos, float shadow){
+    
+    // Attenuation
+    float d = length(l.lightPos - pos);
+    float at = 1.0 / (l.constant + l.linear * d + l.quadratic * (d * d));
+
+    vec4 lightDir = normalize(l.lightPos - pos);
+    vec4 lightDirRef = reflect(-lightDir, normal);
+     
+    vec4 ambient = at * l.aStr * l.lightCol;
+    vec4 diffuse = at * l.dStr * max(dot(lightDir, normal), 0.0) * l.lightCol;
+    vec4 specular = at * l.sStr * pow(max(dot(cDir, lightDirRef), 0.0), 32) * l.lightCol;
+    
+    return (ambient + shadow * (diffuse + specular));
+}
+
+void main(){
+    vec2 uv = gl_FragCoord.xy / screenSize;
+
+    // Background and light meshes aren't lit
+    float depth = texture(gDepth, uv).r;
+    vec4 albedo = texture(gAlbedo, uv);
+    if (depth == 1.0 || albedo.a == 0.0) {
+        discard;
+    }
+
+    // World position from depth
+    vec4 pos = invViewProj * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    pos /= pos.w;
+
+    // The volume covers a bit more than the light reaches
+    Light l = fetchLight(light);
+    if (length(l.lightPos - pos) > radius) {
+        discard;
+    }
+
+    vec4 normal = vec4(texture(gNormal, uv).xyz, 0.0);
+    vec4 camDir = normalize(cameraPos - pos);
+    outPixel = getLight(l, normal, camDir, pos, getShadow(light, l, normal, pos)) * vec4(albedo.rgb, 1.0);
+}
@@ -0,0 +1,11 @@
+#version 330 core
+
+// Light volumes and full screen triangles for the deferred lighting pass
+layout (location = 0) in vec3 position;
+
+// Clip space transform of the light volume, identity for the full screen triangle
+uniform mat4 volume;
+
+void main(){
+    gl_Position = volume * vec4(position, 1.0);
+}
@@ -0,0 +1,5 @@
+#version 330 core
+
+// Depth prepass writes depth only, colour writes are off
+void main(){
+}
@@ -0,0 +1,23 @@
+#version 330 core
+
+// Depth prepass, positions only. gl_Position has to come out bit for bit the same
+// as vertexShader's for the GL_EQUAL shading pass, so it's worked out the same way
+layout (location = 0) in vec3 position;
+layout (location = 3) in mat4 model;        // Per instance or per draw, same as vertexShader
+
+invariant gl_Position;
+
+// Per-frame values filled once by FrameUniforms, must match fragmentShader
+layout (std140) uniform Frame{
+    mat4 view;
+    mat4 projection;
+    vec4 cameraPos;
+    ivec4 clusterGrid;
+    vec4 clusterParams;
+    ivec4 shadowLights;
+    vec4 shadowFar;
+};
+
+void main(){
+    gl_Position = projection * view * model * vec4(position, 1.0);
+}
@@ -3,13 +3,18 @@
 in vec4 pos;                // Point's position
 in vec2 texPos;             // Texture position
 in vec4 normal;             // Normal to point (already normalized)
+flat in vec3 layer;         // uvScale and layer in tex
 
 out vec4 outPixel;
 
-uniform sampler2D tex;
-uniform vec4 cameraPos;     // Camera position in world space.
-uniform vec4 lightPos;      // Light's position in world space.
-uniform vec4 lightColor;    // Light's Color
+uniform sampler2DArray tex;
+
+// Sample this mesh's layer of tex. Padded textures only cover uvScale of the
+// layer, so wrap by hand and use the unwrapped derivatives to keep mip selection smooth
+vec4 sampleLayer(vec2 uv){
+    vec2 scaled = uv * layer.xy;
+    return textureGrad(tex, vec3(fract(uv) * layer.xy, layer.z), dFdx(scaled), dFdy(scaled));
+}
 
 // Struct to hold the light values
 struct Light{
@@ -24,11 +29,62 @@ struct Light{
     float quadratic;
 };
 
-// Going to have 3 light sources
-#define LIGHTS 3
-uniform Light l[LIGHTS];
+// Camera and cluster grid are filled once per frame by FrameUniforms
+layout (std140) uniform Frame{
+    mat4 view;
+    mat4 projection;
+    vec4 cameraPos;         // Camera position in world space.
+    ivec4 clusterGrid;      // Light clusters along x, y, and z
+    vec4 clusterParams;     // Pixels per cluster across and up, depth slice scale and bias
+    ivec4 shadowLights;     // Light each shadow map belongs to, -1 if unused
+    vec4 shadowFar;         // Distance each shadow map reaches
+};
+
+// Lights live in texture buffers filled by LightClusters, 3 texels each
+uniform samplerBuffer lightData;
+uniform usamplerBuffer clusterLights;   // Offset into lightIndices and count, per cluster
+uniform usamplerBuffer lightIndices;
+
+Light fetchLight(int i){
+    vec4 a = texelFetch(lightData, 3 * i);
+    vec4 b = texelFetch(lightData, 3 * i + 1);
+    vec4 c = texelFetch(lightData, 3 * i + 2);
+    return Light(vec4(a.xyz, 1.0), vec4(b.xyz, 1.0), a.w, b.w, c.x, c.y, c.z, c.w);
+}
+
+// Cluster this fragment is in, depth slices are spaced exponentially (see LightClusters)
+int clusterIndex(){
+    float dist = max(-(view * pos).z, 1e-4);
+    ivec3 c = ivec3(gl_FragCoord.xy / clusterParams.xy, log(dist) * clusterParams.z + clusterParams.w);
+    c = clamp(c, ivec3(0), clusterGrid.xyz - 1);
+    return (c.z * clusterGrid.y + c.y) * clusterGrid.x + c.x;
+}
+
+// Cube shadow maps, see ShadowMaps.h. Each stores distance from its light over shadowFar
+uniform samplerCubeShadow shadowMap0;
+uniform samplerCubeShadow shadowMap1;
+uniform samplerCubeShadow shadowMap2;
+
+float sampleShadow(samplerCubeShadow map, vec3 toPoint, float far){
+    float dist = length(toPoint);
+    if (dist >= far) {
+        return 1.0;
+    }
+    return texture(map, vec4(toPoint, (dist - 0.02) / far));
+}
+
+// How much of light l reaches pos past the shadow casters, 1 if it has no shadow map.
+// pos is pushed out along the normal a bit so surfaces don't shadow themselves
+float getShadow(int light, Light l, vec4 normal, vec4 pos){
+    vec3 toPoint = pos.xyz + normal.xyz * 0.02 - l.lightPos.xyz;
+    if (light == shadowLights.x) return sampleShadow(shadowMap0, toPoint, shadowFar.x);
+    if (light == shadowLights.y) return sampleShadow(shadowMap1, toPoint, shadowFar.y);
+    if (light == shadowLights.z) return sampleShadow(shadowMap2, toPoint, shadowFar.z);
+    return 1.0;
+}
 
-vec4 getLight(Light l, vec4 normal, vec4 cDir, vec4 pos){
+// shadow scales the diffuse and specular parts, ambient still reaches shadowed surfaces
+vec4 getLight(Light l, vec4 normal, vec4 cDir, vec4 pos, float shadow){
     
     // Attenuation
     float d = length(l.lightPos - pos);
@@ -49,7 +105,7 @@ vec4 getLight(Light l, vec4 normal, vec4 cDir, vec4 pos){
     // in relation to where the camera is located
     vec4 specular = at * l.sStr * pow(max(dot(cDir, lightDirRef), 0.0), 32) * l.lightCol;
     
-    return (ambient + diffuse + specular);
+    return (ambient + shadow * (diffuse + specular));
 }
 
 
@@ -61,11 +117,14 @@ void main(){
     // Empty vector to add light values to
     vec4 result = vec4(0.0, 0.0, 0.0, 1.0);
 
-    // Sum all of the light values
-    for(int i = 0; i < LIGHTS; i++){
-        result += getLight(l[i], normal, camDir, pos);
+    // Sum the lights that reach this fragment's cluster
+    uvec2 cluster = texelFetch(clusterLights, clusterIndex()).xy;
+    for(uint i = 0u; i < cluster.y; i++){
+        int light = int(texelFetch(lightIndices, int(cluster.x + i)).x);
+        Light l = fetchLight(light);
+        result += getLight(l, normal, camDir, pos, getShadow(light, l, normal, pos));
     }
 
     // Final value
-    outPixel = result * texture(tex, texPos);
+    outPixel = result * sampleLayer(texPos);
 }
\ No newline at end of file
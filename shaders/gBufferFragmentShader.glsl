@@ -0,0 +1,26 @@
+#version 330 core
+
+// G-buffer pass of the deferred renderer, draws with vertexShader in place of fragmentShader
+
+in vec4 pos;                // Point's position
+in vec2 texPos;             // Texture position
+in vec4 normal;             // Normal to point (already normalized)
+flat in vec3 layer;         // uvScale and layer in tex
+
+layout (location = 0) out vec4 gAlbedo;    // Texture color, alpha 1 marks surfaces that get lit
+layout (location = 1) out vec4 gNormal;    // World space normal
+
+uniform sampler2DArray tex;
+
+// Same as fragmentShader's sampleLayer()
+vec4 sampleLayer(vec2 uv){
+    vec2 scaled = uv * layer.xy;
+    return textureGrad(tex, vec3(fract(uv) * layer.xy, layer.z), dFdx(scaled), dFdy(scaled));
+}
+
+void main(){
+
+    // Lighting is done later for just the pixels that end up on screen
+    gAlbedo = vec4(sampleLayer(texPos).rgb, 1.0);
+    gNormal = vec4(normalize(normal.xyz), 0.0);
+}
@@ -2,16 +2,23 @@
 
 // In variables from vertexShader
 in vec2 texPos;
+flat in vec3 layer;
 in vec4 color;
 
 // Out variable for color
 out vec4 outPixel;
 
-// Uniform for tex
-uniform sampler2D tex;
+// Uniform for tex, the layer is picked by layer.z
+uniform sampler2DArray tex;
+
+// Same as fragmentShader's sampleLayer()
+vec4 sampleLayer(vec2 uv){
+    vec2 scaled = uv * layer.xy;
+    return textureGrad(tex, vec3(fract(uv) * layer.xy, layer.z), dFdx(scaled), dFdy(scaled));
+}
 
 void main(){
 
     // Calculate color of point
-    outPixel = texture(tex, texPos) * color;
+    outPixel = sampleLayer(texPos) * color;
 }
\ No newline at end of file
@@ -0,0 +1,23 @@
+#version 330 core
+
+// G-buffer pass for lit light meshes, draws with lsVertexShader in place of lsFragmentShader
+
+in vec2 texPos;
+flat in vec3 layer;
+in vec4 color;
+
+layout (location = 0) out vec4 gAlbedo;    // Final color, alpha 0 so the lighting pass leaves it as is
+layout (location = 1) out vec4 gNormal;
+
+uniform sampler2DArray tex;
+
+// Same as fragmentShader's sampleLayer()
+vec4 sampleLayer(vec2 uv){
+    vec2 scaled = uv * layer.xy;
+    return textureGrad(tex, vec3(fract(uv) * layer.xy, layer.z), dFdx(scaled), dFdy(scaled));
+}
+
+void main(){
+    gAlbedo = vec4((sampleLayer(texPos) * color).rgb, 0.0);
+    gNormal = vec4(0.0);
+}
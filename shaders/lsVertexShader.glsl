@@ -1,17 +1,29 @@
 #version 330 core
 
-// Set locations for in variables
+// Set locations for in variables, these also accept the Compact layout
+// (see vertexShader), model then includes Geometry::dequant
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec2 texturePos;
+layout (location = 3) in mat4 model;        // Set per draw by RenderQueue, same as vertexShader
+layout (location = 10) in vec3 texLayer;
 
 // Out variables being passed to fragmentShader
 out vec2 texPos;
+flat out vec3 layer;
 out vec4 color;
 
+// Per-frame values filled once by FrameUniforms, same block as the other shaders
+layout (std140) uniform Frame{
+    mat4 view;
+    mat4 projection;
+    vec4 cameraPos;
+    ivec4 clusterGrid;      // Light clusters along x, y, and z
+    vec4 clusterParams;     // Pixels per cluster across and up, depth slice scale and bias
+    ivec4 shadowLights;     // Light each shadow map belongs to, -1 if unused
+    vec4 shadowFar;         // Distance each shadow map reaches
+};
+
 // Uniform values
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 uniform vec4 lightColor;
 
 void main(){
@@ -21,5 +33,6 @@ void main(){
     
     // Pass out variables to fragmentShader
     texPos = texturePos;
+    layer = texLayer;
     color = lightColor;
 }
\ No newline at end of file
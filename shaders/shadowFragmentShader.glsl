@@ -0,0 +1,13 @@
+#version 330 core
+
+in vec3 worldPos;
+
+uniform vec3 lightPos;
+uniform float farPlane;     // Distance stored as 1.0
+
+void main(){
+
+    // Distance from the light instead of the projection's depth, so any face
+    // of the cube can be compared the same way when sampling
+    gl_FragDepth = length(worldPos - lightPos) / farPlane;
+}
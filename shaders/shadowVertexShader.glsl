@@ -0,0 +1,15 @@
+#version 330 core
+
+// Casters drawn into one face of a point light's cube shadow map, see ShadowMaps.h
+layout (location = 0) in vec3 position;
+layout (location = 3) in mat4 model;        // Set per draw, includes Geometry::dequant like vertexShader
+
+uniform mat4 faceViewProj;  // The light's view and 90 degree projection for this face
+
+out vec3 worldPos;
+
+void main(){
+    vec4 p = model * vec4(position, 1.0);
+    worldPos = p.xyz;
+    gl_Position = faceViewProj * p;
+}
@@ -1,18 +1,35 @@
 #version 330 core
 
-layout (location = 0) in vec3 position;     // Position
+// Vertex attributes, either floats or the Compact layout (normalized shorts,
+// half floats, 10:10:10:2 normal) which GL converts to these types on fetch
+layout (location = 0) in vec3 position;     // Position, Compact positions are in [-1, 1] and model includes Geometry::dequant
 layout (location = 1) in vec2 texturePos;   // Texture
 layout (location = 2) in vec3 normalPos;    // Normal
 
+// Model and normal matrix, per instance from InstanceGroup's buffer,
+// or set once per draw with glVertexAttrib by setInstanceAttribs() from RenderQueue::draw()
+layout (location = 3) in mat4 model;        // Uses locations 3-6
+layout (location = 7) in mat3 normMat;      // Uses locations 7-9
+layout (location = 10) in vec3 texLayer;    // uvScale and layer in the bound texture array
+
 out vec4 pos;       // Position passed to fragmentShader
 out vec2 texPos;    // Texture passed to fragmentShader
 out vec4 normal;    // Normal passed to fragmentShader
+flat out vec3 layer;    // texLayer passed to fragmentShader
+
+// Computed the same way in depthVertexShader, invariant so the depth prepass and this pass match exactly
+invariant gl_Position;
 
-// Uniform mats from Mesh::render()
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform mat3 normMat;
+// Per-frame values filled once by FrameUniforms, must match fragmentShader
+layout (std140) uniform Frame{
+    mat4 view;
+    mat4 projection;
+    vec4 cameraPos;     // Camera position in world space.
+    ivec4 clusterGrid;      // Light clusters along x, y, and z
+    vec4 clusterParams;     // Pixels per cluster across and up, depth slice scale and bias
+    ivec4 shadowLights;     // Light each shadow map belongs to, -1 if unused
+    vec4 shadowFar;         // Distance each shadow map reaches
+};
 
 void main(){
     gl_Position = projection * view * model * vec4(position, 1.0);  // Calculate final position
@@ -22,6 +39,7 @@ void main(){
     
     // Pass texture pos to fragmentShader
     texPos = texturePos;
+    layer = texLayer;
 
     // Pass normals multiplied by normMat to fragmentShader
     normal = normalize(vec4(normMat * normalPos, 0.0));
@@ -0,0 +1,139 @@
+#ifndef ANIMATIONSYSTEM_
+#define ANIMATIONSYSTEM_
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include "LightMesh.h"
+#include "Mesh.h"
+#include "TransformSystem.h"
+
+
+// Time an animation follows. Sim time can fall behind real time when frames stall
+// and runs a step a frame headless, Wall always keeps up with real time
+enum class AnimationClock {
+    Sim,
+    Wall
+};
+
+
+// Procedural animation worked out from a time value instead of stepped frame to frame,
+// so nothing drifts however long it runs or however uneven the frames are.
+// Each animation follows either the simulation's time or the wall clock (see AnimationClock).
+// Each kind of animation is kept in its own arrays and update() does every one of a
+// kind in a single loop, there's no per-animation object or virtual call
+class AnimationSystem {
+
+public:
+
+    // Counts from the last update()
+    struct Stats {
+        int spins = 0;
+        int colorCycles = 0;
+        int moved = 0;          // spins whose angle changed, so their transform was set
+    };
+
+private:
+
+    TransformSystem& transforms;
+
+    // Wall time is seconds since this, steady so it doesn't jump when the system clock is changed
+    std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+
+    // Spins, rotation of a transform about an axis through its parent's origin.
+    // The local matrix is rotate(angle, axis) * base, angle = degreesPerSecond * (time + offset),
+    // held for tick seconds at a time if tick isn't 0. time is from the spin's clock
+    std::vector<int> spinTransforms;
+    std::vector<AnimationClock> spinClocks;
+    std::vector<glm::mat4> spinBases;
+    std::vector<glm::vec3> spinAxes;
+    std::vector<double> spinRates;
+    std::vector<double> spinTicks;
+    std::vector<double> spinOffsets;
+    std::vector<float> spinAngles;      // Angle last set, NAN before the first update()
+
+    // Color cycles, channel c of the light's color is sin(radiansPerSecond * time + phase[c])
+    std::vector<LightMesh*> colorLights;
+    std::vector<double> colorRates;
+    std::vector<glm::vec3> colorPhases;
+
+    Stats stats;
+
+public:
+
+    AnimationSystem(TransformSystem& t) : transforms(t) {}
+
+    // Spin mesh about axis (in its parent's space) starting from its current local matrix.
+    // offset is added to the time, so a spin can start partway through
+    void addSpin(Mesh& mesh, glm::vec3 axis, double degreesPerSecond, double tick = 0.0, double offset = 0.0,
+                 AnimationClock clock = AnimationClock::Sim) {
+        spinTransforms.push_back(mesh.getTransform());
+        spinClocks.push_back(clock);
+        spinBases.push_back(mesh.getLocal());
+        spinAxes.push_back(glm::normalize(axis));
+        spinRates.push_back(degreesPerSecond);
+        spinTicks.push_back(tick);
+        spinOffsets.push_back(offset);
+        spinAngles.push_back(NAN);
+    }
+
+    // Cycle light's color, each channel a sine wave offset by phases
+    void addColorCycle(LightMesh& light, double radiansPerSecond, glm::vec3 phases) {
+        colorLights.push_back(&light);
+        colorRates.push_back(radiansPerSecond);
+        colorPhases.push_back(phases);
+    }
+
+    // Seconds of wall time since the system was made, what Wall animations follow
+    double getWallTime() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    }
+
+    // Set every animation to where it is at simTime seconds of sim time and the current wall time
+    void update(double simTime) {
+        double wallTime = getWallTime();
+        stats.spins = spinTransforms.size();
+        stats.colorCycles = colorLights.size();
+        stats.moved = 0;
+
+        // Angles first, wrapped in double so they stay exact at large times.
+        // Only transforms whose angle changed are set, so ticking spins leave the scene graph (and the shadow maps) alone between ticks
+        for (size_t i = 0; i < spinTransforms.size(); i++) {
+            double t = (spinClocks[i] == AnimationClock::Wall ? wallTime : simTime) + spinOffsets[i];
+            if (spinTicks[i] > 0.0) {
+                t = std::floor(t / spinTicks[i]) * spinTicks[i];
+            }
+            float angle = (float)std::fmod(spinRates[i] * t, 360.0);
+            if (angle == spinAngles[i]) {
+                continue;
+            }
+            spinAngles[i] = angle;
+            transforms.set(spinTransforms[i], glm::rotate(glm::mat4(1.0f), glm::radians(angle), spinAxes[i]) * spinBases[i]);
+            stats.moved++;
+        }
+
+        for (size_t i = 0; i < colorLights.size(); i++) {
+            float phase = (float)std::fmod(colorRates[i] * simTime, 2.0 * glm::pi<double>());
+            colorLights[i]->updateLightColor(glm::vec3(
+                std::sin(phase + colorPhases[i].x),
+                std::sin(phase + colorPhases[i].y),
+                std::sin(phase + colorPhases[i].z)
+            ));
+        }
+    }
+
+    // Get counts from the last update()
+    const Stats& getStats() const { return stats; }
+};
+
+// toString for AnimationSystem::Stats
+std::ostream& operator<<(std::ostream& os, const AnimationSystem::Stats& s) {
+    os << "Spins: " << s.spins << " (" << s.moved << " moved), Color cycles: " << s.colorCycles;
+    return os;
+}
+
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef ASSETLOADER_
+#define ASSETLOADER_
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ThreadPool.h"
+
+
+// Loads Textures and Geometry in two steps. decode (reading files, stbi, Assimp)
+// runs on a pool of worker threads, and upload (every GL call) runs on the
+// thread that owns the context as soon as each decode finishes
+class AssetLoader {
+
+private:
+
+    struct Asset {
+        std::string name;
+        std::function<void()> decode;
+        std::function<void()> upload;
+        double decodeMs = 0.0;
+    };
+
+    std::vector<Asset> assets;
+
+    using Clock = std::chrono::steady_clock;
+
+    static double msSince(Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+public:
+
+    // Queue an asset, decode runs on a worker and upload on the GL thread during loadAll()
+    void add(const std::string& name, std::function<void()> decode, std::function<void()> upload) {
+        assets.push_back({ name, std::move(decode), std::move(upload) });
+    }
+
+    // Load everything queued, must be called from the thread that owns the GL context
+    void loadAll(int threads = 0) {
+        if (assets.empty()) {
+            return;
+        }
+
+        Clock::time_point start = Clock::now();
+
+        std::mutex mutex;
+        std::condition_variable decoded;
+        std::deque<int> ready;
+
+        double uploadMs = 0.0;
+        int workerCount;
+        {
+            ThreadPool pool(threads);
+            workerCount = pool.size();
+
+            // Decode everything in parallel
+            for (int i = 0; i < assets.size(); i++) {
+                pool.submit([this, i, &mutex, &decoded, &ready] {
+                    Clock::time_point t = Clock::now();
+                    assets[i].decode();
+                    assets[i].decodeMs = msSince(t);
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        ready.push_back(i);
+                    }
+                    decoded.notify_one();
+                });
+            }
+
+            // Upload each asset on this thread as soon as it's decoded
+            for (int uploaded = 0; uploaded < assets.size(); uploaded++) {
+                int i;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    decoded.wait(lock, [&ready] { return !ready.empty(); });
+                    i = ready.front();
+                    ready.pop_front();
+                }
+                Clock::time_point t = Clock::now();
+                assets[i].upload();
+                uploadMs += msSince(t);
+            }
+        }
+
+        double totalMs = msSince(start);
+
+        // Startup timing report
+        double decodeMs = 0.0;
+        const Asset* slowest = &assets[0];
+        for (auto& a : assets) {
+            decodeMs += a.decodeMs;
+            if (a.decodeMs > slowest->decodeMs) {
+                slowest = &a;
+            }
+        }
+        std::cout << "Loaded " << assets.size() << " assets in " << totalMs << " ms on " << workerCount << " threads" << std::endl;
+        std::cout << "\tdecode: " << decodeMs << " ms total, " << decodeMs / totalMs << "x parallel" << std::endl;
+        std::cout << "\tupload: " << uploadMs << " ms" << std::endl;
+        std::cout << "\tslowest: " << slowest->name << " (" << slowest->decodeMs << " ms)" << std::endl;
+
+        assets.clear();
+    }
+};
+
+
+#endif
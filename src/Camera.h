@@ -34,21 +34,31 @@ private:
 	// View mat
 	mat4 view;
 
+	// pos before the last step(), and the position view was last built from,
+	// see interpolate()
+	vec3 prevPos;
+	vec3 viewPos;
+
 	// Proj Matrix
 	float fov;
 	float aspect;
+	float zNear = 0.1f;
+	float zFar = 100.0f;
 	glm::mat4 projection;
 
 	// Boolean for if movement is enabled
 	bool movement = false;
 
+	// Movement speed in units per second
+	float moveSpeed = 3.0f;
+
 public:
 
 	Camera(vec3 cPos, vec3 cTar, vec3 upV, float fov_, float a):
-		pos(cPos), target(cTar), up(upV), fov(fov_), aspect(a) {
+		pos(cPos), target(cTar), up(upV), prevPos(cPos), viewPos(cPos), fov(fov_), aspect(a) {
 
 		// Create proj mat
-		projection = glm::perspective(glm::radians(fov), aspect, 0.1f, 100.0f);
+		projection = glm::perspective(glm::radians(fov), aspect, zNear, zFar);
 
 		// Calculate dir and right based on params
 		dir = normalize(target-pos); 
@@ -101,6 +111,7 @@ public:
 	void updateView() {
 		right = normalize(cross(up, dir));
 		front = normalize(cross(right, up));
+		viewPos = pos;
 		view = lookAt(
 			pos,
 			dir + pos,
@@ -111,6 +122,8 @@ public:
 	// Update pos, dir, up, right, front, and view
 	void updateView(glm::vec3 p, glm::vec3 d, glm::vec3 u) { 
 		pos = p;
+		prevPos = p;
+		viewPos = p;
 		dir = d;
 		up = u; 
 
@@ -130,39 +143,61 @@ public:
 		movement = !movement;
 	}
 
-	void camera_callback(Window w) {
+	// Move for the keys held down over one fixed step of dt seconds
+	void step(Window& w, float dt) {
 		GLFWwindow* window = w.getWindow();
+		float dist = moveSpeed * dt;
+		prevPos = pos;
 
-		// If screen is paused, disable mouse and move controls, unlock mouse
+		// If screen is paused, disable move controls
 		if (!w.isPaused()) {
 
 			// If movement is disabled, disable move controls
 			if (movement) {
 				if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
 					std::cout << "Hit W" << std::endl;
-					move(0.05f);
+					move(dist);
 				}
 				if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
 					std::cout << "Hit A" << std::endl;
-					strafe(-0.05f);
+					strafe(-dist);
 				}
 				if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
 					std::cout << "Hit S" << std::endl;
-					move(-0.05f);
+					move(-dist);
 				}
 				if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
 					std::cout << "Hit D" << std::endl;
-					strafe(0.05f);
+					strafe(dist);
 				}
 				if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) {
 					std::cout << "Hit LShift" << std::endl;
-					height(-0.05f);
+					height(-dist);
 				}
 				if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) {
 					std::cout << "Hit Space" << std::endl;
-					height(0.05f);
+					height(dist);
 				}
 			}
+		}
+	}
+
+	// Build view from between the last two steps, alpha of the way from the one before to the last.
+	// Leaves view alone if it's already there
+	void interpolate(float alpha) {
+		vec3 p = mix(prevPos, pos, alpha);
+		if (p != viewPos) {
+			viewPos = p;
+			view = lookAt(p, p + dir, up);
+		}
+	}
+
+	// Look around with the mouse, once per frame
+	void look(Window& w) {
+		GLFWwindow* window = w.getWindow();
+
+		// If screen is paused, disable mouse controls, unlock mouse
+		if (!w.isPaused()) {
 
 			// Get Cursor Pos
 			double x, y;
@@ -194,6 +229,10 @@ public:
 	mat4& getProj() { return projection; }
 	mat4& setProj(mat4 m) { this->projection = m; }
 
+	// Getters for the near and far plane distances
+	float getNear() { return zNear; }
+	float getFar() { return zFar; }
+
 	// Getter and Setter for pos
 	vec3& getPos() { return pos; };
 	vec3& setPos(vec3 vec) { this->pos = vec; };
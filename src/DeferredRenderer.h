@@ -0,0 +1,278 @@
+#ifndef DEFERREDRENDERER_
+#define DEFERREDRENDERER_
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include "Camera.h"
+#include "GLState.h"
+#include "Light.h"
+#include "Shader.h"
+
+
+// Texture units the G-buffer is bound to while lighting, 0 is left for the material texture arrays
+constexpr int GBUFFER_ALBEDO_UNIT = 1;
+constexpr int GBUFFER_NORMAL_UNIT = 2;
+constexpr int GBUFFER_DEPTH_UNIT = 3;
+
+
+// Deferred shading. Meshes are drawn once into a G-buffer (albedo, normal, depth)
+// with the G-buffer shaders swapped in through RenderQueue::setOverride(), then
+// each light is drawn as a sphere covering the distance it reaches, shading only
+// the pixels under it. Lighting costs lit screen area instead of lights x fragments
+class DeferredRenderer {
+
+public:
+
+    // Counts from the last light()
+    struct Stats {
+        int volumes = 0;        // lights drawn as a sphere
+        int fullScreen = 0;     // lights the camera was inside, drawn over the whole screen
+        int skipped = 0;        // lights that are off
+
+        // Every draw call lighting made, the composite pass included
+        int draws = 0;
+        long long triangles = 0;
+    };
+
+private:
+
+    // Sphere detail, and how much bigger than radius the sphere is drawn so its flat faces still cover it
+    static constexpr int SLICES = 12;
+    static constexpr int STACKS = 8;
+    static constexpr float VOLUME_SCALE = 1.1f;
+
+    // Size of the G-buffer, follows the framebuffer being lit (see resize())
+    int width = 0, height = 0;
+    Shader& composite;
+    Shader& lighting;
+
+    GLuint fbo{};
+    GLuint albedo{}, normal{}, depth{};
+
+    // Unit sphere and a triangle covering the screen
+    GLuint sphereVao{}, sphereVbo{}, sphereEbo{};
+    GLsizei sphereCount = 0;
+    GLuint screenVao{}, screenVbo{};
+
+    Uniform<glm::mat4> uCompositeVolume, uVolume, uInvViewProj;
+    Uniform<int> uLight;
+    Uniform<float> uRadius;
+
+    Stats stats;
+
+    // Create a width x height G-buffer texture
+    GLuint makeTarget(int unit, GLint internalFormat, GLenum format, GLenum type) {
+        GLuint id;
+        glGenTextures(1, &id);
+        GLState::get().bindTexture(unit, GL_TEXTURE_2D, id);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return id;
+    }
+
+    // Positions only vao for verticies, at attribute 0
+    GLuint makeVao(const std::vector<glm::vec3>& verticies, GLuint& vbo) {
+        GLuint vao;
+        glGenVertexArrays(1, &vao);
+        GLState::get().bindVertexArray(vao);
+        glGenBuffers(1, &vbo);
+        GLState::get().bindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, verticies.size() * sizeof(glm::vec3), verticies.data(), GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+        glEnableVertexAttribArray(0);
+        return vao;
+    }
+
+    // Latitude/longitude sphere of radius 1, wound counter clockwise from outside
+    void makeSphere() {
+        std::vector<glm::vec3> verticies;
+        for (int st = 0; st <= STACKS; st++) {
+            float phi = glm::pi<float>() * st / STACKS;
+            for (int sl = 0; sl <= SLICES; sl++) {
+                float theta = 2.0f * glm::pi<float>() * sl / SLICES;
+                verticies.push_back(glm::vec3(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta)));
+            }
+        }
+
+        std::vector<GLushort> elements;
+        for (int st = 0; st < STACKS; st++) {
+            for (int sl = 0; sl < SLICES; sl++) {
+                GLushort a = st * (SLICES + 1) + sl, b = a + SLICES + 1;
+                elements.insert(elements.end(), { a, (GLushort)(a + 1), b, b, (GLushort)(a + 1), (GLushort)(b + 1) });
+            }
+        }
+
+        sphereVao = makeVao(verticies, sphereVbo);
+        glGenBuffers(1, &sphereEbo);
+        GLState::get().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphereEbo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, elements.size() * sizeof(GLushort), elements.data(), GL_STATIC_DRAW);
+        sphereCount = elements.size();
+    }
+
+    // Point the G-buffer samplers of shader at their units
+    void bindSamplers(Shader& shader) {
+        shader.use();
+        shader.getUniform<int>("gAlbedo").set(GBUFFER_ALBEDO_UNIT);
+        shader.getUniform<int>("gNormal").set(GBUFFER_NORMAL_UNIT);
+        shader.getUniform<int>("gDepth").set(GBUFFER_DEPTH_UNIT);
+    }
+
+    // Make the G-buffer fbWidth x fbHeight, recreating the targets if it isn't already.
+    // The shaders find their G-buffer texel from gl_FragCoord, so it has to match the framebuffer being lit
+    void resize(int fbWidth, int fbHeight) {
+        fbWidth = std::max(fbWidth, 1);
+        fbHeight = std::max(fbHeight, 1);
+        if (fbWidth == width && fbHeight == height) {
+            return;
+        }
+        width = fbWidth;
+        height = fbHeight;
+
+        // Deleting unbinds them behind GLState's back, and the new ones can get the same ids
+        GLuint old[] = { albedo, normal, depth };
+        glDeleteTextures(3, old);
+        GLState::get().invalidate();
+        albedo = makeTarget(GBUFFER_ALBEDO_UNIT, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+        normal = makeTarget(GBUFFER_NORMAL_UNIT, GL_RGBA16F, GL_RGBA, GL_FLOAT);
+        depth = makeTarget(GBUFFER_DEPTH_UNIT, GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedo, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normal, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+        GLenum buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, buffers);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cout << "G-buffer is incomplete" << std::endl;
+            exit(-5);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        composite.use();
+        composite.getUniform<glm::vec2>("screenSize").set(glm::vec2(width, height));
+        lighting.use();
+        lighting.getUniform<glm::vec2>("screenSize").set(glm::vec2(width, height));
+    }
+
+    void drawScreen() {
+        GLState::get().bindVertexArray(screenVao);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        stats.draws++;
+        stats.triangles++;
+    }
+
+public:
+
+    // width x height G-buffer to start with, composite and lighting are the deferred shaders (see main.cpp)
+    DeferredRenderer(int width, int height, Shader& composite, Shader& lighting)
+        : composite(composite), lighting(lighting) {
+
+        glGenFramebuffers(1, &fbo);
+        resize(width, height);
+
+        makeSphere();
+        screenVao = makeVao({ glm::vec3(-1.0f, -1.0f, 0.0f), glm::vec3(3.0f, -1.0f, 0.0f), glm::vec3(-1.0f, 3.0f, 0.0f) }, screenVbo);
+
+        bindSamplers(composite);
+        uCompositeVolume = composite.getUniform<glm::mat4>("volume");
+        uCompositeVolume.set(glm::mat4(1.0f));
+
+        bindSamplers(lighting);
+        uVolume = lighting.getUniform<glm::mat4>("volume");
+        uInvViewProj = lighting.getUniform<glm::mat4>("invViewProj");
+        uLight = lighting.getUniform<int>("light");
+        uRadius = lighting.getUniform<float>("radius");
+    }
+
+    // Bind the G-buffer, sized for a fbWidth x fbHeight framebuffer, and clear its depth.
+    // Draw meshes with the G-buffer shaders after this
+    void beginGeometry(int fbWidth, int fbHeight) {
+        resize(fbWidth, fbHeight);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+
+    // Light the G-buffer into target (see Window::getFramebuffer()), a fbWidth x fbHeight framebuffer.
+    // lights must be in the same order they were passed to LightClusters::update() this frame, which uploads them
+    void light(Camera& c, const std::vector<Light*>& lights, GLuint target, int fbWidth, int fbHeight) {
+        resize(fbWidth, fbHeight);
+        stats = Stats{};
+        GLState& state = GLState::get();
+
+        glBindFramebuffer(GL_FRAMEBUFFER, target);
+        glDisable(GL_DEPTH_TEST);
+        glDepthMask(GL_FALSE);
+
+        state.bindTexture(GBUFFER_ALBEDO_UNIT, GL_TEXTURE_2D, albedo);
+        state.bindTexture(GBUFFER_NORMAL_UNIT, GL_TEXTURE_2D, normal);
+        state.bindTexture(GBUFFER_DEPTH_UNIT, GL_TEXTURE_2D, depth);
+
+        // Light meshes, and black under everything else for the lights to add onto
+        composite.use();
+        drawScreen();
+
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        glEnable(GL_CULL_FACE);
+
+        glm::mat4 viewProj = c.getProj() * c.getView();
+        lighting.use();
+        uInvViewProj.set(glm::inverse(viewProj));
+
+        for (int i = 0; i < lights.size(); i++) {
+            const Light& l = *lights[i];
+            float radius = lightRadius(l);
+            if (radius <= 0.0f) {
+                stats.skipped++;
+                continue;
+            }
+            uLight.set(i);
+            uRadius.set(std::min(radius, 1.0e30f));
+
+            // From inside the sphere, or if it never falls off, every pixel could be lit.
+            // Otherwise draw the back of the sphere so it still covers pixels when it crosses the near plane
+            float reach = radius * VOLUME_SCALE;
+            if (std::isinf(radius) || glm::length(c.getPos() - l.lightPos) < reach + c.getNear()) {
+                glCullFace(GL_BACK);
+                uVolume.set(glm::mat4(1.0f));
+                drawScreen();
+                stats.fullScreen++;
+            }
+            else {
+                glCullFace(GL_FRONT);
+                uVolume.set(viewProj * glm::scale(glm::translate(glm::mat4(1.0f), l.lightPos), glm::vec3(reach)));
+                state.bindVertexArray(sphereVao);
+                glDrawElements(GL_TRIANGLES, sphereCount, GL_UNSIGNED_SHORT, (void*)0);
+                stats.volumes++;
+                stats.draws++;
+                stats.triangles += sphereCount / 3;
+            }
+        }
+
+        glDisable(GL_CULL_FACE);
+        glDisable(GL_BLEND);
+        glDepthMask(GL_TRUE);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    // Get counts from the last light()
+    const Stats& getStats() const { return stats; }
+};
+
+// toString for DeferredRenderer::Stats
+std::ostream& operator<<(std::ostream& os, const DeferredRenderer::Stats& s) {
+    os << "Light volumes: " << s.volumes << ", Full screen lights: " << s.fullScreen << ", Lights off: " << s.skipped << ", Lighting draws: " << s.draws << " (" << s.triangles << " triangles)";
+    return os;
+}
+
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef FRAGMENTCOUNTER_
+#define FRAGMENTCOUNTER_
+
+#include <GL/glew.h>
+#include <iostream>
+
+
+// Counts the fragments shaded between begin() and end() each frame, to measure overdraw.
+// Uses GL_FRAGMENT_SHADER_INVOCATIONS when the driver has ARB_pipeline_statistics_query,
+// otherwise GL_SAMPLES_PASSED, which is the same count as long as early depth testing
+// throws away the fragments that fail (true for every program without discard or gl_FragDepth).
+// Like Profiler, queries are used in turn and only read once they're available
+class FragmentCounter {
+
+public:
+
+    struct Stats {
+        bool invocations = false;       // counting shader invocations, not samples passed
+        long long fragments = 0;        // newest result
+        double average = 0.0;           // over the last WINDOW results
+    };
+
+private:
+
+    static constexpr int RING = 4;
+    static constexpr int WINDOW = 120;
+
+    GLenum target;
+    GLuint queries[RING]{};
+    bool pending[RING]{};
+    int next = 0;
+    bool active = false;
+
+    long long history[WINDOW]{};
+    int count = 0;
+
+    Stats stats;
+
+    // Read every query that finished, without waiting on any that haven't. Oldest first, starting at next
+    void collect() {
+        for (int k = 0; k < RING; k++) {
+            int i = (next + k) % RING;
+            if (!pending[i]) {
+                continue;
+            }
+            GLint available = 0;
+            glGetQueryObjectiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) {
+                continue;
+            }
+            GLuint64 result = 0;
+            glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &result);
+            pending[i] = false;
+
+            stats.fragments = (long long)result;
+            history[count % WINDOW] = stats.fragments;
+            count++;
+        }
+
+        int n = count < WINDOW ? count : WINDOW;
+        long long total = 0;
+        for (int i = 0; i < n; i++) {
+            total += history[i];
+        }
+        stats.average = n > 0 ? (double)total / n : 0.0;
+    }
+
+public:
+
+    FragmentCounter() {
+        stats.invocations = GLEW_ARB_pipeline_statistics_query;
+        target = stats.invocations ? GL_FRAGMENT_SHADER_INVOCATIONS_ARB : GL_SAMPLES_PASSED;
+        glGenQueries(RING, queries);
+    }
+
+    // Start counting, once per frame around the passes to measure
+    void begin() {
+        collect();
+
+        // Still waiting on the GPU from RING frames ago, skip counting this frame
+        if (pending[next]) {
+            return;
+        }
+        glBeginQuery(target, queries[next]);
+        pending[next] = true;
+        active = true;
+    }
+
+    void end() {
+        if (!active) {
+            return;
+        }
+        glEndQuery(target);
+        active = false;
+        next = (next + 1) % RING;
+    }
+
+    // Get the newest count and the rolling average
+    const Stats& getStats() const { return stats; }
+};
+
+// toString for FragmentCounter::Stats
+std::ostream& operator<<(std::ostream& os, const FragmentCounter::Stats& s) {
+    os << (s.invocations ? "Fragment shader invocations: " : "Samples passed: ") << s.fragments << " (average " << (long long)s.average << ")";
+    return os;
+}
+
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef FRAMETIMING_
+#define FRAMETIMING_
+
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+
+// How finished frames are shown
+//   VSync:    wait for the display's refresh, glfwSwapInterval(1)
+//   Uncapped: swap as soon as the frame is done, for measuring throughput
+//   Limited:  swap without vsync but no more than the frame limit per second
+enum class PresentMode {
+    VSync,
+    Uncapped,
+    Limited
+};
+
+// PRESENT_MODE=vsync|uncapped|limited, vsync if it isn't set or isn't one of those
+inline PresentMode presentModeFromEnv() {
+    const char* v = std::getenv("PRESENT_MODE");
+    std::string mode = v ? v : "";
+    if (mode == "uncapped") {
+        return PresentMode::Uncapped;
+    }
+    if (mode == "limited") {
+        return PresentMode::Limited;
+    }
+    return PresentMode::VSync;
+}
+
+
+// Runs the simulation in steps of a fixed length no matter the frame rate.
+// Each frame advance() takes the real time since the last one and gives the number of
+// steps to run, what's left over carries to the next frame and alpha() is how far it
+// is towards the next step, for blending between the last two steps when rendering
+class FixedTimestep {
+
+private:
+    double step;
+    double accumulator = 0.0;
+    long long stepCount = 0;
+
+    // Longest frame that's caught up on, so a stall (loading, a breakpoint)
+    // doesn't leave every later frame running steps to catch up
+    double maxFrame = 0.25;
+
+public:
+
+    // Take in the number of steps per second
+    FixedTimestep(double rate) : step(1.0 / rate) {}
+
+    // Add frameTime seconds and get the number of steps to run this frame
+    int advance(double frameTime) {
+        accumulator += std::min(frameTime, maxFrame);
+        int steps = (int)(accumulator / step);
+        accumulator -= steps * step;
+        stepCount += steps;
+        return steps;
+    }
+
+    // How far past the last step this frame is, 0 to 1
+    float alpha() const { return (float)(accumulator / step); }
+
+    // Length of a step in seconds
+    double getStep() const { return step; }
+
+    // Simulation time in seconds of this frame, between the last step and the next
+    double getRenderTime() const { return (stepCount + accumulator / step) * step; }
+};
+
+
+// Measures the time between frames and holds them to the present mode
+class FramePacer {
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    PresentMode mode;
+    int limit;                  // Frames per second in Limited
+    Clock::time_point last;
+    Clock::time_point deadline;
+
+public:
+
+    // Take in the mode to start in and the frame limit used by Limited
+    FramePacer(PresentMode m, int fpsLimit) : mode(m), limit(std::max(fpsLimit, 1)), last(Clock::now()), deadline(last) {}
+
+    // Set the swap interval for mode, needs the window's context to be current
+    void setMode(PresentMode m) {
+        mode = m;
+        glfwSwapInterval(mode == PresentMode::VSync ? 1 : 0);
+        deadline = Clock::now();
+    }
+
+    // Go to the next mode, VSync, Uncapped, then Limited
+    void cycleMode() {
+        setMode(mode == PresentMode::VSync ? PresentMode::Uncapped : mode == PresentMode::Uncapped ? PresentMode::Limited : PresentMode::VSync);
+    }
+
+    // Seconds since the last call, once at the start of every frame
+    double tick() {
+        Clock::time_point now = Clock::now();
+        double dt = std::chrono::duration<double>(now - last).count();
+        last = now;
+        return dt;
+    }
+
+    // In Limited, wait until it's time for the next frame, call right before swapping.
+    // Sleeps until close then spins the rest since sleeps can overshoot by a few ms
+    void wait() {
+        if (mode != PresentMode::Limited) {
+            return;
+        }
+        Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / limit));
+        Clock::time_point now = Clock::now();
+
+        // Fell behind, start counting from now rather than rushing frames to catch up
+        if (deadline < now - period) {
+            deadline = now;
+        }
+        if (deadline - now > std::chrono::milliseconds(2)) {
+            std::this_thread::sleep_for(deadline - now - std::chrono::milliseconds(2));
+        }
+        while (Clock::now() < deadline) {
+            std::this_thread::yield();
+        }
+        deadline += period;
+    }
+
+    PresentMode getMode() const { return mode; }
+    int getLimit() const { return limit; }
+};
+
+// toString for PresentMode
+std::ostream& operator<<(std::ostream& os, PresentMode m) {
+    os << (m == PresentMode::VSync ? "VSync" : m == PresentMode::Uncapped ? "Uncapped" : "Limited");
+    return os;
+}
+
+
+#endif
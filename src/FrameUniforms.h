@@ -0,0 +1,77 @@
+#ifndef FRAMEUNIFORMS_
+#define FRAMEUNIFORMS_
+
+#include <GL/glew.h>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "GLState.h"
+#include "Shader.h"
+#include "Camera.h"
+#include "LightClusters.h"
+#include "ShadowMaps.h"
+
+// Binding point the Frame block is attached to in every program
+constexpr GLuint FRAME_BLOCK_BINDING = 0;
+
+
+// Holds the uniform buffer for the std140 "Frame" block in the shaders.
+// Camera matrices, the light cluster grid, and which lights have shadow maps
+// only change once per frame, so they are uploaded here once and every program
+// reads them from the same buffer. The lights themselves are in LightClusters' texture buffers
+class FrameUniforms {
+
+private:
+
+    // std140 layout of the whole Frame block
+    struct FrameData {
+        glm::mat4 view;
+        glm::mat4 projection;
+        glm::vec4 cameraPos;
+        glm::ivec4 clusterGrid;
+        glm::vec4 clusterParams;
+        glm::ivec4 shadowLights;
+        glm::vec4 shadowFar;
+    };
+
+    static_assert(sizeof(FrameData) == 208, "FrameData must match std140 layout of Frame");
+
+    unsigned int ubo{};
+    FrameData data{};
+
+public:
+
+    FrameUniforms() {
+
+        // Create the buffer and attach it to the Frame binding point
+        glGenBuffers(1, &ubo);
+        GLState::get().bindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), NULL, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_BLOCK_BINDING, ubo);
+    }
+
+    // Point the Frame block of shader at this buffer
+    void attach(Shader& shader) {
+        shader.bindUniformBlock("Frame", FRAME_BLOCK_BINDING);
+    }
+
+    // Pack the camera, cluster grid, and shadow lights and upload them, call once per frame
+    // before drawing and after clusters.update() and shadows.update() so they're current
+    void update(Camera& c, const LightClusters& clusters, const ShadowMaps& shadows) {
+        data.view = c.getView();
+        data.projection = c.getProj();
+        data.cameraPos = glm::vec4(c.getPos(), 1.0f);
+        data.clusterGrid = glm::ivec4(clusters.getGrid());
+        data.clusterParams = clusters.getParams();
+        data.shadowLights = shadows.getLightIndices();
+        data.shadowFar = shadows.getFarPlanes();
+
+        // Orphan the old storage so the driver doesn't wait on last frame's draws
+        GLState::get().bindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), NULL, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameData), &data);
+    }
+};
+
+
+#endif
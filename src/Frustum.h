@@ -0,0 +1,128 @@
+#ifndef FRUSTUM_
+#define FRUSTUM_
+
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+
+// SSE is always there on x64, MSVC doesn't define __SSE__ so check its macros too
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FRUSTUM_SSE
+#include <xmmintrin.h>
+#endif
+
+
+// Axis aligned bounding box
+struct AABB {
+    glm::vec3 min{ INFINITY };
+    glm::vec3 max{ -INFINITY };
+
+    // Grow to hold b
+    void merge(const AABB& b) {
+        min = glm::min(min, b.min);
+        max = glm::max(max, b.max);
+    }
+
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+    glm::vec3 extent() const { return (max - min) * 0.5f; }
+};
+
+// World space box around the local box [bmin, bmax] moved by model.
+// Transforms the center and takes |model| times the half size, so it's
+// as tight as an AABB around the 8 moved corners without moving all 8
+inline AABB transformAABB(const glm::vec3& bmin, const glm::vec3& bmax, const glm::mat4& model) {
+    glm::vec3 c = (bmin + bmax) * 0.5f;
+    glm::vec3 e = (bmax - bmin) * 0.5f;
+
+    glm::vec3 worldC = glm::vec3(model * glm::vec4(c, 1.0f));
+    glm::vec3 worldE{ 0.0f };
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            worldE[i] += std::abs(model[j][i]) * e[j];
+        }
+    }
+    return AABB{ worldC - worldE, worldC + worldE };
+}
+
+
+// Result of testing a box against a Frustum
+enum class Cull {
+    Outside,        // Fully outside one plane, nothing in it can be seen
+    Intersect,      // Crosses at least one plane
+    Inside          // Inside every plane, nothing in it needs testing again
+};
+
+
+// The 6 planes of a view frustum, normals pointing in.
+// Stored as x, y, z, d lanes (2 padding planes that pass everything) so a box
+// is tested against 4 planes at a time
+class Frustum {
+
+private:
+    alignas(16) float nx[8], ny[8], nz[8], d[8];
+    alignas(16) float ax[8], ay[8], az[8];     // |nx|, |ny|, |nz|
+
+public:
+
+    // Pull the planes out of projection * view (Gribb and Hartmann)
+    Frustum(const glm::mat4& viewProj) {
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; i++) {
+            rows[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+        }
+
+        // left, right, bottom, top, near, far
+        glm::vec4 planes[6] = {
+            rows[3] + rows[0], rows[3] - rows[0],
+            rows[3] + rows[1], rows[3] - rows[1],
+            rows[3] + rows[2], rows[3] - rows[2]
+        };
+
+        for (int i = 0; i < 8; i++) {
+            glm::vec4 p = i < 6 ? planes[i] / glm::length(glm::vec3(planes[i])) : glm::vec4(0.0f, 0.0f, 0.0f, INFINITY);
+            nx[i] = p.x; ny[i] = p.y; nz[i] = p.z; d[i] = p.w;
+            ax[i] = std::abs(p.x); ay[i] = std::abs(p.y); az[i] = std::abs(p.z);
+        }
+    }
+
+    // Test box against every plane
+    Cull test(const AABB& box) const {
+        glm::vec3 c = box.center();
+        glm::vec3 e = box.extent();
+
+#ifdef FRUSTUM_SSE
+        __m128 cx = _mm_set1_ps(c.x), cy = _mm_set1_ps(c.y), cz = _mm_set1_ps(c.z);
+        __m128 ex = _mm_set1_ps(e.x), ey = _mm_set1_ps(e.y), ez = _mm_set1_ps(e.z);
+        __m128 zero = _mm_setzero_ps();
+        int outside = 0, crossing = 0;
+
+        for (int i = 0; i < 8; i += 4) {
+
+            // Signed distance of the center and the box's reach along each normal
+            __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(nx + i), cx), _mm_mul_ps(_mm_load_ps(ny + i), cy)),
+                                     _mm_add_ps(_mm_mul_ps(_mm_load_ps(nz + i), cz), _mm_load_ps(d + i)));
+            __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(ax + i), ex), _mm_mul_ps(_mm_load_ps(ay + i), ey)),
+                                      _mm_mul_ps(_mm_load_ps(az + i), ez));
+
+            outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(dist, reach), zero));
+            crossing |= _mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(dist, reach), zero));
+        }
+#else
+        bool outside = false, crossing = false;
+        for (int i = 0; i < 6; i++) {
+            float dist = nx[i] * c.x + ny[i] * c.y + nz[i] * c.z + d[i];
+            float reach = ax[i] * e.x + ay[i] * e.y + az[i] * e.z;
+            outside |= dist + reach < 0.0f;
+            crossing |= dist - reach < 0.0f;
+        }
+#endif
+
+        if (outside) {
+            return Cull::Outside;
+        }
+        return crossing ? Cull::Intersect : Cull::Inside;
+    }
+};
+
+
+#endif
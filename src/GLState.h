@@ -0,0 +1,165 @@
+#ifndef GLSTATE_
+#define GLSTATE_
+
+#include <GL/glew.h>
+#include <iostream>
+
+
+// Cache of the GL bindings that change while rendering (program, vao, buffers,
+// and the texture bound to each unit). Every bind goes through here and is
+// only passed on to GL if it changes something, so callers can just bind what
+// they need without checking. Anything binding these directly with gl* calls
+// has to call invalidate() after, or the cache will skip binds it shouldn't
+class GLState {
+
+public:
+
+    // Counts since the last beginFrame()
+    struct Stats {
+        int issued = 0;     // binds passed on to GL
+        int elided = 0;     // binds skipped since they were already in place
+    };
+
+    // Highest texture unit tracked, units past this are always bound
+    static constexpr int MAX_UNITS = 16;
+
+private:
+
+    // No GL object has this id, so it marks bindings that aren't known
+    static constexpr GLuint UNKNOWN = ~0u;
+
+    // Texture targets and buffer targets tracked, see textureIndex() and bufferIndex()
+    static constexpr int TEXTURE_TARGET_COUNT = 4;
+    static constexpr int BUFFER_TARGET_COUNT = 4;
+
+    GLuint program;
+    GLuint vao;
+    GLuint activeUnit;
+    GLuint textures[MAX_UNITS][TEXTURE_TARGET_COUNT];
+    GLuint buffers[BUFFER_TARGET_COUNT];
+    Stats stats;
+
+    GLState() { invalidate(); }
+
+    static int textureIndex(GLenum target) {
+        switch (target) {
+        case GL_TEXTURE_2D: return 0;
+        case GL_TEXTURE_2D_ARRAY: return 1;
+        case GL_TEXTURE_CUBE_MAP: return 2;
+        case GL_TEXTURE_BUFFER: return 3;
+        default: return -1;
+        }
+    }
+
+    static int bufferIndex(GLenum target) {
+        switch (target) {
+        case GL_ARRAY_BUFFER: return 0;
+        case GL_ELEMENT_ARRAY_BUFFER: return 1;
+        case GL_UNIFORM_BUFFER: return 2;
+        case GL_TEXTURE_BUFFER: return 3;
+        default: return -1;
+        }
+    }
+
+    // Record value as bound in cached, returns false if it already was
+    bool change(GLuint& cached, GLuint value) {
+        if (cached == value) {
+            stats.elided++;
+            return false;
+        }
+        cached = value;
+        stats.issued++;
+        return true;
+    }
+
+public:
+
+    // There's one GL context, so one cache
+    static GLState& get() {
+        static GLState state;
+        return state;
+    }
+
+    GLState(const GLState&) = delete;
+    GLState& operator=(const GLState&) = delete;
+
+    // Forget every cached binding so the next bind of each is always issued
+    void invalidate() {
+        program = vao = activeUnit = UNKNOWN;
+        for (auto& unit : textures) {
+            for (auto& t : unit) {
+                t = UNKNOWN;
+            }
+        }
+        for (auto& b : buffers) {
+            b = UNKNOWN;
+        }
+    }
+
+    void useProgram(GLuint id) {
+        if (change(program, id)) {
+            glUseProgram(id);
+        }
+    }
+
+    // The element buffer binding belongs to the vao, so it's unknown after switching
+    void bindVertexArray(GLuint id) {
+        if (change(vao, id)) {
+            glBindVertexArray(id);
+            buffers[bufferIndex(GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+        }
+    }
+
+    void bindBuffer(GLenum target, GLuint id) {
+        int i = bufferIndex(target);
+        if (i < 0) {
+            stats.issued++;
+            glBindBuffer(target, id);
+            return;
+        }
+        if (change(buffers[i], id)) {
+            glBindBuffer(target, id);
+        }
+    }
+
+    void activeTexture(GLuint unit) {
+        if (change(activeUnit, unit)) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+        }
+    }
+
+    // Bind id to target on unit, switching the active unit only if the bind is needed
+    void bindTexture(GLuint unit, GLenum target, GLuint id) {
+        int i = textureIndex(target);
+        if (i < 0 || unit >= MAX_UNITS) {
+            activeTexture(unit);
+            stats.issued++;
+            glBindTexture(target, id);
+            return;
+        }
+        if (textures[unit][i] == id) {
+            stats.elided++;
+            return;
+        }
+        activeTexture(unit);
+        change(textures[unit][i], id);
+        glBindTexture(target, id);
+    }
+
+    // Reset the counts, call once at the top of each frame
+    void beginFrame() {
+        stats = Stats{};
+    }
+
+    // Get counts since the last beginFrame()
+    const Stats& getStats() const { return stats; }
+};
+
+// toString for GLState::Stats
+std::ostream& operator<<(std::ostream& os, const GLState::Stats& s) {
+    os << "GL binds issued: " << s.issued << ", Elided: " << s.elided;
+    return os;
+}
+
+
+#endif
@@ -0,0 +1,503 @@
+#ifndef GEOMETRY_
+#define GEOMETRY_
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "AssetLoader.h"
+#include "GLState.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include "Simplify.h"
+#include "VertexFormat.h"
+
+// Attribute locations of the per-instance model (mat4, 4 slots) and
+// normal (mat3, 3 slots) matrices and the texture array layer
+// (uvScale and layer, see Texture::layerAttrib()) in vertexShader.glsl
+constexpr GLuint INSTANCE_MODEL_ATTRIB = 3;
+constexpr GLuint INSTANCE_NORMAL_ATTRIB = 7;
+constexpr GLuint INSTANCE_TEXTURE_ATTRIB = 10;
+
+// Set the model and normal matrix and texture layer for a draw that doesn't use an instance buffer.
+// The instance attributes aren't enabled in a plain Geometry vao, so GL reads
+// these current values for every vertex instead
+inline void setInstanceAttribs(const glm::mat4& model, const glm::mat3& normMat, const glm::vec3& texLayer) {
+    for (int i = 0; i < 4; i++) {
+        glVertexAttrib4fv(INSTANCE_MODEL_ATTRIB + i, glm::value_ptr(model[i]));
+    }
+    for (int i = 0; i < 3; i++) {
+        glVertexAttrib3fv(INSTANCE_NORMAL_ATTRIB + i, glm::value_ptr(normMat[i]));
+    }
+    glVertexAttrib3fv(INSTANCE_TEXTURE_ATTRIB, glm::value_ptr(texLayer));
+}
+
+
+// Models with at least LOD_MIN_TRIANGLES triangles get LOD_LEVELS levels of detail,
+// level l keeps about LOD_FRACTIONS[l] of each submesh's triangles
+constexpr int LOD_LEVELS = 4;
+constexpr float LOD_FRACTIONS[LOD_LEVELS] = { 1.0f, 0.5f, 0.25f, 0.1f };
+constexpr size_t LOD_MIN_TRIANGLES = 2000;
+
+// Share of the screen's height a mesh's bounding sphere has to drop below to draw level l + 1
+// instead of level l, and how far past that it has to go before the level changes so a mesh
+// sitting right on one doesn't flicker between levels
+constexpr float LOD_SCREEN_SIZES[LOD_LEVELS - 1] = { 0.3f, 0.15f, 0.06f };
+constexpr float LOD_HYSTERESIS = 0.15f;
+
+// Level of detail for a mesh covering size of the screen's height, out of levels, drawn at current last frame
+inline int selectLod(int current, float size, int levels) {
+    current = std::min(current, levels - 1);
+
+    // Keep current while size is inside its range widened by LOD_HYSTERESIS
+    bool finer = current > 0 && size > LOD_SCREEN_SIZES[current - 1] * (1.0f + LOD_HYSTERESIS);
+    bool coarser = current < levels - 1 && size < LOD_SCREEN_SIZES[current] * (1.0f - LOD_HYSTERESIS);
+    if (!finer && !coarser) {
+        return current;
+    }
+
+    int level = 0;
+    while (level < levels - 1 && size < LOD_SCREEN_SIZES[level]) {
+        level++;
+    }
+    return level;
+}
+
+
+// A set of a Geometry's submeshes drawn together, laid out for glMultiDrawElementsBaseVertex
+struct DrawRange {
+    std::vector<GLsizei> counts;
+    std::vector<const void*> offsets;
+    std::vector<GLint> baseVertices;
+};
+
+
+// Class for the GPU side of a model, one per .obj file.
+// Holds the vao, vbo, and ebo that every Mesh using this model draws from.
+// Every submesh in the file is packed into the same vbo and ebo.
+// Nothing but path and format is valid until the AssetLoader has loaded it
+class Geometry {
+public:
+
+    // ebo, vao, and vbo
+    unsigned int ebo{};
+    unsigned int vao{};
+    unsigned int vbo{};
+
+    // Holds number of elements to draw and their type
+    int size{};
+    GLenum indexType = GL_UNSIGNED_INT;
+
+    // Submeshes in the file for every level of detail, lodCount levels one after the
+    // other, and the number of material slots they use. Every level is in the same vbo and ebo
+    std::vector<Submesh> submeshes;
+    int materialCount{};
+    int lodCount = 1;
+
+    // Every submesh at full detail, what draw() uses
+    DrawRange all;
+
+    // Triangles in each level of detail
+    std::vector<long long> lodTriangles;
+
+    // Layout of the vbo
+    VertexFormat format;
+
+    // Takes positions in the vbo to model space, identity unless format is Compact.
+    // Applied on top of a Mesh's model matrix for position only, never the normal matrix
+    glm::mat4 dequant{ 1.0f };
+
+    // Model space bounding box
+    glm::vec3 boundsMin{};
+    glm::vec3 boundsMax{};
+
+    // Path of the .obj this was loaded from
+    std::string path;
+
+    // Queue the model on loader, it's decoded and uploaded during loader.loadAll()
+    Geometry(AssetLoader& loader, const std::string& p, VertexFormat f = VertexFormat::Float) : format(f), path(p) {
+        loader.add(path, [this] { decode(); }, [this] { upload(); });
+    }
+
+    // Draw every submesh, vao (or another vao set up with bindAttributes()) must be bound
+    void draw() {
+        draw(all);
+    }
+
+    // Draw the submeshes in range with a single call
+    void draw(const DrawRange& range) {
+        if (range.counts.size() == 1) {
+            glDrawElementsBaseVertex(GL_TRIANGLES, range.counts[0], indexType, (void*)range.offsets[0], range.baseVertices[0]);
+        }
+        else if (!range.counts.empty()) {
+            glMultiDrawElementsBaseVertex(GL_TRIANGLES, range.counts.data(), indexType, range.offsets.data(),
+                range.counts.size(), range.baseVertices.data());
+        }
+    }
+
+    // Draw count instances of every submesh, the bound vao must have been set up with bindAttributes()
+    void drawInstanced(int count) {
+        drawInstanced(all, count);
+    }
+
+    // Draw count instances of the submeshes in range, GL 3.3 has no instanced multi-draw
+    // so this is one call per submesh with the binds shared
+    void drawInstanced(const DrawRange& range, int count) {
+        for (int i = 0; i < range.counts.size(); i++) {
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.counts[i], indexType, (void*)range.offsets[i], count, range.baseVertices[i]);
+        }
+    }
+
+    // Build the DrawRange for every submesh in level of detail level whose material slot is set in useMaterial
+    DrawRange makeRange(const std::vector<bool>& useMaterial, int level = 0) const {
+        DrawRange range;
+        GLsizei indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+        size_t perLevel = submeshes.size() / lodCount;
+        for (size_t i = level * perLevel; i < (level + 1) * perLevel; i++) {
+            const Submesh& sm = submeshes[i];
+            if (sm.material < useMaterial.size() && useMaterial[sm.material]) {
+                range.counts.push_back(sm.indexCount);
+                range.offsets.push_back((const void*)((size_t)sm.firstIndex * indexSize));
+                range.baseVertices.push_back(sm.baseVertex);
+            }
+        }
+        return range;
+    }
+
+    // Bind vbo and ebo and set up the vertex attributes in the currently bound vao,
+    // used by other vaos (like InstanceGroup's) that draw from this model's buffers
+    void bindAttributes() {
+        GLState::get().bindBuffer(GL_ARRAY_BUFFER, vbo);
+        GLState::get().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+
+        if (format == VertexFormat::Compact) {
+            bindCompactAttributes();
+            return;
+        }
+
+        //position
+        glVertexAttribPointer(
+            0,                                      //attribute of vertex shader
+            3,                                      //number of elements per vertex
+            GL_FLOAT,                               //data type of each element
+            GL_FALSE,                               //take values as is
+            8 * sizeof(GLfloat),                    //next point appears every 8 floats
+            0                                       //offset of the first element
+        );
+        glEnableVertexAttribArray(0);
+
+        //texturePos
+        glVertexAttribPointer(
+            1,                                      //attribute of vertex shader
+            2,                                      //number of elements per vertex
+            GL_FLOAT,                               //data type of each element
+            GL_FALSE,                               //take values as is
+            8 * sizeof(GLfloat),                    //next point appears every 8 floats
+            (void*)(3 * sizeof(GLfloat))            //offset of the first element
+        );
+        glEnableVertexAttribArray(1);
+
+        //normalPos
+        glVertexAttribPointer(
+            2,                                      //attribute of vertex shader
+            3,                                      //number of elements per vertex
+            GL_FLOAT,                               //data type of each element
+            GL_FALSE,                               //take values as is
+            8 * sizeof(GLfloat),                    //next point appears every 8 floats
+            (void*)(5 * sizeof(GLfloat))            //offset of the first element
+        );
+        glEnableVertexAttribArray(2);
+    }
+
+private:
+
+    // Decoded model, only held between decode() and upload().
+    // Either the mapped cache or the verticies and elements from Assimp
+    std::unique_ptr<MeshCache> cache;
+    std::vector<GLfloat> pendingVerticies;
+    std::vector<GLuint> pendingElements;
+    bool loadFailed = false;
+
+    // Read the model from the cache or Assimp, runs on a loader thread so no GL calls here
+    void decode() {
+
+        // Use the preprocessed cache if it was built from the current .obj,
+        // upload() then reads straight from the mapped file
+        uint64_t sourceHash = hashFile(path);
+        cache = std::make_unique<MeshCache>(path, sourceHash);
+        if (sourceHash != 0 && cache->valid()) {
+            const MeshCacheHeader& h = cache->getHeader();
+            boundsMin = glm::vec3(h.boundsMin[0], h.boundsMin[1], h.boundsMin[2]);
+            boundsMax = glm::vec3(h.boundsMax[0], h.boundsMax[1], h.boundsMax[2]);
+            submeshes.assign(cache->submeshes(), cache->submeshes() + h.submeshCount * h.lodCount);
+            materialCount = h.materialCount;
+            lodCount = h.lodCount;
+            countLods();
+            return;
+        }
+        cache.reset();
+
+        // Otherwise import it with Assimp and write the cache for next time
+        if (!loadObject(path, pendingVerticies, pendingElements, submeshes, materialCount)) {
+            loadFailed = true;
+            return;
+        }
+
+        buildLods(pendingVerticies, pendingElements);
+        countLods();
+
+        if (!MeshCache::write(path, sourceHash, pendingVerticies, pendingElements, submeshes, materialCount, lodCount, glm::value_ptr(boundsMin), glm::value_ptr(boundsMax))) {
+            std::cout << "Couldn't write mesh cache " << MeshCache::cachePath(path) << std::endl;
+        }
+    }
+
+    // Append coarser levels of detail to elements after the full model, one set of submeshes per level.
+    // Each level is simplified from the one before it and indexes the same verticies
+    void buildLods(const std::vector<GLfloat>& verticies, std::vector<GLuint>& elements) {
+        if (elements.size() / 3 < LOD_MIN_TRIANGLES) {
+            return;
+        }
+
+        size_t perLevel = submeshes.size();
+        for (int l = 1; l < LOD_LEVELS; l++) {
+            for (size_t i = 0; i < perLevel; i++) {
+                Submesh sm = submeshes[(l - 1) * perLevel + i];
+                const Submesh& full = submeshes[i];
+
+                // Only the submesh's own verticies, its elements are relative to baseVertex
+                GLuint vertexCount = 0;
+                for (size_t j = 0; j < full.indexCount; j++) {
+                    vertexCount = std::max(vertexCount, elements[full.firstIndex + j] + 1);
+                }
+                size_t target = (size_t)(full.indexCount * LOD_FRACTIONS[l]) / 3 * 3;
+                std::vector<GLuint> lod = simplifyElements(verticies.data() + 8 * (size_t)sm.baseVertex, vertexCount,
+                    elements.data() + sm.firstIndex, sm.indexCount, target);
+
+                sm.firstIndex = elements.size();
+                sm.indexCount = lod.size();
+                elements.insert(elements.end(), lod.begin(), lod.end());
+                submeshes.push_back(sm);
+            }
+        }
+        lodCount = LOD_LEVELS;
+    }
+
+    // Fill size and lodTriangles from submeshes
+    void countLods() {
+        size_t perLevel = submeshes.size() / lodCount;
+        lodTriangles.assign(lodCount, 0);
+        for (size_t i = 0; i < submeshes.size(); i++) {
+            lodTriangles[i / perLevel] += submeshes[i].indexCount / 3;
+        }
+        size = lodTriangles[0] * 3;
+    }
+
+    // Create the GL buffers from the decoded model, runs on the GL thread
+    void upload() {
+        if (loadFailed) {
+            std::cout << "Error loading Mesh. Make sure meshes are at ./objects/<model>.obj relative to \"Mesh.h\"" << std::endl;
+            exit(-1);
+        }
+
+        if (cache) {
+            const MeshCacheHeader& h = cache->getHeader();
+            setup(cache->verticies(), h.vertexCount, cache->elements(), h.indexCount);
+            cache.reset();
+        }
+        else {
+            setup(pendingVerticies.data(), pendingVerticies.size() / 8, pendingElements.data(), pendingElements.size());
+            std::vector<GLfloat>().swap(pendingVerticies);
+            std::vector<GLuint>().swap(pendingElements);
+        }
+    }
+
+    // Compact layout, see VertexFormat.h. The shaders still read vec3/vec2/vec3,
+    // GL converts the normalized shorts, halfs, and packed normal when fetching
+    void bindCompactAttributes() {
+
+        //position, normalized to [-1, 1] and scaled back by dequant
+        glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, pos));
+        glEnableVertexAttribArray(0);
+
+        //texturePos
+        glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, uv));
+        glEnableVertexAttribArray(1);
+
+        //normalPos, packed types always take 4 components, the shader ignores w
+        glVertexAttribPointer(2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(CompactVertex), (void*)offsetof(CompactVertex, normal));
+        glEnableVertexAttribArray(2);
+    }
+
+    // Upload verticies (8 float layout) and elements, converting to format first
+    void setup(const GLfloat* verticies, size_t vertexCount, const GLuint* elements, size_t elementCount) {
+
+        // Creating and binding vao first, the ebo binding goes into whichever vao is bound
+        GLState& state = GLState::get();
+        glGenVertexArrays(1, &vao);
+        state.bindVertexArray(vao);
+
+        // Creating and binding vertex and element buffer objects
+        glGenBuffers(1, &vbo);
+        state.bindBuffer(GL_ARRAY_BUFFER, vbo);
+        glGenBuffers(1, &ebo);
+        state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+
+        if (format == VertexFormat::Compact) {
+
+            // Quantize verticies into the bounding box
+            std::vector<CompactVertex> compact = compactVerticies(verticies, vertexCount, boundsMin, boundsMax);
+            glBufferData(GL_ARRAY_BUFFER, compact.size() * sizeof(CompactVertex), compact.data(), GL_STATIC_DRAW);
+            dequant = dequantizeMatrix(boundsMin, boundsMax);
+
+            // 16 bit elements if every index fits, they're relative to each submesh's baseVertex
+            GLuint maxElement = 0;
+            for (size_t i = 0; i < elementCount; i++) {
+                maxElement = std::max(maxElement, elements[i]);
+            }
+            if (maxElement < 65536) {
+                std::vector<GLushort> shortElements(elements, elements + elementCount);
+                glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortElements.size() * sizeof(GLushort), shortElements.data(), GL_STATIC_DRAW);
+                indexType = GL_UNSIGNED_SHORT;
+            }
+            else {
+                glBufferData(GL_ELEMENT_ARRAY_BUFFER, elementCount * sizeof(GLuint), elements, GL_STATIC_DRAW);
+            }
+        }
+        else {
+            glBufferData(GL_ARRAY_BUFFER, vertexCount * 8 * sizeof(GLfloat), verticies, GL_STATIC_DRAW);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, elementCount * sizeof(GLuint), elements, GL_STATIC_DRAW);
+        }
+
+        // Setting up attributes
+        bindAttributes();
+
+        all = makeRange(std::vector<bool>(materialCount, true));
+    }
+
+    // Loading in the object from a file using Assimp.
+    // Every mesh in the file is appended to verticies and elements, with its
+    // elements left relative to its own first vertex (baseVertex)
+    bool loadObject(const std::string& path, std::vector<GLfloat>& verticies, std::vector<GLuint>& elements,
+                    std::vector<Submesh>& submeshes, int& materialCount) {
+
+        Assimp::Importer importer;
+
+        // Import the scene from the file
+        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+
+        // If it failed, return false and escalate the error to the constructor by returning false
+        if (!scene || scene->mNumMeshes == 0) {
+            std::cout << importer.GetErrorString() << std::endl;
+            return false;
+        }
+
+        // Count everything first so the vectors only allocate once
+        unsigned int totalVerticies = 0, totalFaces = 0;
+        for (unsigned int m = 0; m < scene->mNumMeshes; m++) {
+            totalVerticies += scene->mMeshes[m]->mNumVertices;
+            totalFaces += scene->mMeshes[m]->mNumFaces;
+        }
+        verticies.reserve(8 * totalVerticies);
+        elements.reserve(3 * totalFaces);
+
+        // Materials get dense slots in the order they're first used
+        std::unordered_map<unsigned int, uint32_t> materialSlots;
+
+        boundsMin = glm::vec3(INFINITY);
+        boundsMax = glm::vec3(-INFINITY);
+
+        for (unsigned int m = 0; m < scene->mNumMeshes; m++) {
+            const aiMesh* mesh = scene->mMeshes[m];
+
+            auto slot = materialSlots.emplace(mesh->mMaterialIndex, (uint32_t)materialSlots.size()).first;
+
+            Submesh sm;
+            sm.firstIndex = elements.size();
+            sm.baseVertex = verticies.size() / 8;
+            sm.material = slot->second;
+
+            bool hasUVs = mesh->HasTextureCoords(0);
+            bool hasNormals = mesh->HasNormals();
+
+            // Fill verticies
+            for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
+
+                // Get pos, tex, and norm coordinates, meshes without UVs or normals get 0s
+                aiVector3D pos = mesh->mVertices[i];
+                aiVector3D UVW = hasUVs ? mesh->mTextureCoords[0][i] : aiVector3D{ 0.0f, 0.0f, 0.0f };
+                aiVector3D norm = hasNormals ? mesh->mNormals[i] : aiVector3D{ 0.0f, 0.0f, 0.0f };
+
+                // Grow bounding box
+                boundsMin = glm::min(boundsMin, glm::vec3(pos.x, pos.y, pos.z));
+                boundsMax = glm::max(boundsMax, glm::vec3(pos.x, pos.y, pos.z));
+
+                // Insert coordinates into verticies in the order that matches the glAttribPointers
+                verticies.push_back((GLfloat)pos.x);
+                verticies.push_back((GLfloat)pos.y);
+                verticies.push_back((GLfloat)pos.z);
+                verticies.push_back((GLfloat)UVW.x);
+                verticies.push_back((GLfloat)UVW.y);
+                verticies.push_back((GLfloat)norm.x);
+                verticies.push_back((GLfloat)norm.y);
+                verticies.push_back((GLfloat)norm.z);
+            }
+
+            // Fill face indices, skipping points and lines left over after triangulating
+            for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+                if (mesh->mFaces[i].mNumIndices != 3) {
+                    continue;
+                }
+
+                // Insert elements into element vector
+                elements.push_back(mesh->mFaces[i].mIndices[0]);
+                elements.push_back(mesh->mFaces[i].mIndices[1]);
+                elements.push_back(mesh->mFaces[i].mIndices[2]);
+            }
+
+            sm.indexCount = elements.size() - sm.firstIndex;
+            submeshes.push_back(sm);
+        }
+
+        materialCount = materialSlots.size();
+        return true;
+    }
+};
+
+
+// Holds one Geometry per .obj path (and vertex format) so models used
+// by several Mesh objects are only imported and uploaded once
+class GeometryCache {
+private:
+    AssetLoader& loader;
+    std::unordered_map<std::string, std::unique_ptr<Geometry>> geometry;
+
+public:
+
+    GeometryCache(AssetLoader& l) : loader(l) {}
+
+    // Get the Geometry for path, queueing it on the loader the first time it's asked for
+    Geometry& get(const std::string& path, VertexFormat format = VertexFormat::Float) {
+        std::string key = format == VertexFormat::Compact ? path + "#compact" : path;
+        auto it = geometry.find(key);
+        if (it == geometry.end()) {
+            it = geometry.emplace(key, std::make_unique<Geometry>(loader, path, format)).first;
+        }
+        return *it->second;
+    }
+
+    // Number of unique models loaded
+    int count() const { return geometry.size(); }
+};
+
+
+#endif
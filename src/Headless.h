@@ -0,0 +1,212 @@
+#ifndef HEADLESS_
+#define HEADLESS_
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Surfaceless EGL is a Mesa thing, so headless mode is Linux only
+#ifndef _WIN32
+#define HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+
+// Settings for headless mode. Read from the environment since the Window is
+// created before main() runs
+//   HEADLESS=1              render offscreen through EGL instead of opening a window
+//   HEADLESS_FRAMES=n       frames to render before exiting, 500 if not set
+//   HEADLESS_REPORT=path    where to write the JSON report, benchmark.json if not set
+//   HEADLESS_TRACE=path     also write the pass timings as a Chrome trace, off if not set
+struct HeadlessConfig {
+    bool enabled = false;
+    int frames = 500;
+    std::string report = "benchmark.json";
+    std::string trace;
+
+    static HeadlessConfig fromEnv() {
+        HeadlessConfig c;
+        const char* v = std::getenv("HEADLESS");
+        c.enabled = v && std::string(v) != "0";
+        if (const char* f = std::getenv("HEADLESS_FRAMES")) {
+            c.frames = std::max(1, std::atoi(f));
+        }
+        if (const char* r = std::getenv("HEADLESS_REPORT")) {
+            c.report = r;
+        }
+        if (const char* t = std::getenv("HEADLESS_TRACE")) {
+            c.trace = t;
+        }
+        return c;
+    }
+};
+
+
+// OpenGL 3.3 context with no window or surface, and a framebuffer to draw into instead.
+// Works without a display or GPU through Mesa's llvmpipe
+class HeadlessContext {
+
+private:
+#ifdef HEADLESS_EGL
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+#endif
+    GLuint fbo{}, color{}, depth{};
+
+public:
+
+    HeadlessContext() = default;
+
+    // Owns the EGL display and context, a copy would tear them down when it's destroyed
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+    // Create the context and make it current, returns false if EGL can't give us one
+    bool createContext() {
+#ifdef HEADLESS_EGL
+        auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (!getPlatformDisplay) {
+            std::cout << "EGL_EXT_platform_base not supported" << std::endl;
+            return false;
+        }
+
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) {
+            std::cout << "Couldn't open a surfaceless EGL display" << std::endl;
+            return false;
+        }
+
+        // Same version and profile the window asks GLFW for
+        eglBindAPI(EGL_OPENGL_API);
+        EGLint attribs[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 3,
+            EGL_CONTEXT_MINOR_VERSION, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+            EGL_NONE
+        };
+        context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attribs);
+        if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+            std::cout << "Couldn't create an OpenGL 3.3 EGL context: " << std::hex << eglGetError() << std::dec << std::endl;
+            return false;
+        }
+        return true;
+#else
+        std::cout << "Headless mode needs EGL, which isn't available on this platform" << std::endl;
+        return false;
+#endif
+    }
+
+    // Create a width x height color and depth framebuffer and draw into it from now on.
+    // Call after GLEW is initialized
+    bool createFramebuffer(int width, int height) {
+        glGenRenderbuffers(1, &color);
+        glBindRenderbuffer(GL_RENDERBUFFER, color);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+        glGenRenderbuffers(1, &depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cout << "Headless framebuffer is incomplete" << std::endl;
+            return false;
+        }
+        glViewport(0, 0, width, height);
+        return true;
+    }
+
+    // Framebuffer everything is drawn into
+    GLuint getFramebuffer() const { return fbo; }
+
+    ~HeadlessContext() {
+#ifdef HEADLESS_EGL
+        if (display != EGL_NO_DISPLAY) {
+            eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            if (context != EGL_NO_CONTEXT) {
+                eglDestroyContext(display, context);
+            }
+            eglTerminate(display);
+        }
+#endif
+    }
+};
+
+
+// Times every frame of a headless run and writes the results as JSON
+class FrameBenchmark {
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point frameStart;
+    std::vector<double> frameMs;
+    long long draws = 0;
+    long long triangles = 0;
+
+public:
+
+    void beginFrame() {
+        frameStart = Clock::now();
+    }
+
+    // Finish the frame's GL work so the time covers the rendering, not just submitting it
+    void endFrame(int frameDraws, long long frameTriangles) {
+        glFinish();
+        frameMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count());
+        draws += frameDraws;
+        triangles += frameTriangles;
+    }
+
+    int frames() const { return frameMs.size(); }
+
+    // Write min, mean, p99, and max frame time plus average draws and triangles per frame to path
+    bool writeReport(const std::string& path, int width, int height) const {
+        if (frameMs.empty()) {
+            return false;
+        }
+
+        std::vector<double> sorted = frameMs;
+        std::sort(sorted.begin(), sorted.end());
+        double total = 0.0;
+        for (double ms : sorted) {
+            total += ms;
+        }
+        size_t p99 = std::min(sorted.size() - 1, (size_t)(0.99 * sorted.size()));
+        int n = sorted.size();
+
+        std::ofstream out(path, std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+        out << "{\n"
+            << "  \"renderer\": \"" << (const char*)glGetString(GL_RENDERER) << "\",\n"
+            << "  \"width\": " << width << ",\n"
+            << "  \"height\": " << height << ",\n"
+            << "  \"frames\": " << n << ",\n"
+            << "  \"frame_ms\": {\n"
+            << "    \"min\": " << sorted.front() << ",\n"
+            << "    \"mean\": " << total / n << ",\n"
+            << "    \"p99\": " << sorted[p99] << ",\n"
+            << "    \"max\": " << sorted.back() << "\n"
+            << "  },\n"
+            << "  \"draw_calls_per_frame\": " << (double)draws / n << ",\n"
+            << "  \"triangles_per_frame\": " << (double)triangles / n << "\n"
+            << "}\n";
+        return (bool)out;
+    }
+};
+
+
+#endif
@@ -0,0 +1,249 @@
+#ifndef INSTANCEGROUP_
+#define INSTANCEGROUP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "Geometry.h"
+#include "Mesh.h"
+#include "RenderQueue.h"
+
+
+// Group of Mesh objects that share Geometry and Shader and whose textures are in the same texture arrays.
+// Their model and normal matrices and texture layers go into per-instance vertex buffers
+// and the whole group is drawn with one glDrawElementsInstanced call per texture range
+// and level of detail in use
+class InstanceGroup {
+
+private:
+
+    // Per-instance values, laid out to match the instance attributes in vertexShader.glsl
+    struct InstanceData {
+        glm::mat4 model;
+        glm::mat3 normMat;
+    };
+
+    // Everything in the group draws with these
+    Geometry& geometry;
+    Shader& shader;
+
+    // Meshes in the group, they all split their submeshes into the same ranges
+    std::vector<Mesh*> instances;
+
+    // Every level of detail gets room for every instance, GL 3.3 can't start an
+    // instanced draw partway into the buffer so each level needs its own vaos.
+    // One vao per level and texture range (vaos[l * ranges + r]), each drawing from geometry's
+    // vbo/ebo plus that level's part of instanceVbo and that level and range's part of layerVbo
+    std::vector<unsigned int> vaos;
+    unsigned int instanceVbo{};
+    unsigned int layerVbo{};
+
+    // CPU copies of the instance and layer buffers, refilled each frame with only the visible instances.
+    // Level l's instances start at l * instances.size() in data, and range r's layers at
+    // (l * ranges + r) * instances.size() in layers
+    std::vector<InstanceData> data;
+    std::vector<glm::vec3> layers;
+    std::vector<int> lodVisible;
+    std::vector<float> lodDepth;
+
+    // Set by build() when there's something for upload() to send
+    bool uploadPending = false;
+
+public:
+
+    // Take in the meshes to group, they must all share Geometry, Shader, and texture arrays (see instanceKey())
+    InstanceGroup(const std::vector<Mesh*>& meshes)
+        : geometry(meshes[0]->getGeometry()), shader(meshes[0]->getShader()), instances(meshes) {
+
+        const std::vector<MaterialRange>& ranges = instances[0]->getRanges();
+        int levels = geometry.lodCount;
+        int n = instances.size();
+        data.resize(levels * n);
+        lodVisible.resize(levels);
+        lodDepth.resize(levels);
+
+        GLState& state = GLState::get();
+
+        // Creating the instance buffer
+        glGenBuffers(1, &instanceVbo);
+        state.bindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+        glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+
+        // Creating the layer buffer, room for every instance in every range at every level
+        layers.resize(levels * ranges.size() * n);
+        glGenBuffers(1, &layerVbo);
+        state.bindBuffer(GL_ARRAY_BUFFER, layerVbo);
+        glBufferData(GL_ARRAY_BUFFER, layers.size() * sizeof(glm::vec3), NULL, GL_STREAM_DRAW);
+
+        vaos.resize(levels * ranges.size());
+        for (int l = 0; l < levels; l++) {
+            size_t instanceOffset = l * n * sizeof(InstanceData);
+            for (int r = 0; r < ranges.size(); r++) {
+                int slot = l * ranges.size() + r;
+
+                // Creating and binding vao, then setting up the per-vertex attributes from geometry
+                glGenVertexArrays(1, &vaos[slot]);
+                state.bindVertexArray(vaos[slot]);
+                geometry.bindAttributes();
+
+                // model, one vec4 attribute per column, advancing once per instance
+                state.bindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+                for (int i = 0; i < 4; i++) {
+                    glVertexAttribPointer(INSTANCE_MODEL_ATTRIB + i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                        (void*)(instanceOffset + offsetof(InstanceData, model) + i * sizeof(glm::vec4)));
+                    glEnableVertexAttribArray(INSTANCE_MODEL_ATTRIB + i);
+                    glVertexAttribDivisor(INSTANCE_MODEL_ATTRIB + i, 1);
+                }
+
+                // normMat, one vec3 attribute per column, advancing once per instance
+                for (int i = 0; i < 3; i++) {
+                    glVertexAttribPointer(INSTANCE_NORMAL_ATTRIB + i, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                        (void*)(instanceOffset + offsetof(InstanceData, normMat) + i * sizeof(glm::vec3)));
+                    glEnableVertexAttribArray(INSTANCE_NORMAL_ATTRIB + i);
+                    glVertexAttribDivisor(INSTANCE_NORMAL_ATTRIB + i, 1);
+                }
+
+                // Texture layer for range r at level l, advancing once per instance
+                state.bindBuffer(GL_ARRAY_BUFFER, layerVbo);
+                glVertexAttribPointer(INSTANCE_TEXTURE_ATTRIB, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3),
+                    (void*)(slot * n * sizeof(glm::vec3)));
+                glEnableVertexAttribArray(INSTANCE_TEXTURE_ATTRIB);
+                glVertexAttribDivisor(INSTANCE_TEXTURE_ATTRIB, 1);
+            }
+        }
+    }
+
+    // Gather the visible instances' matrices and layers and add one instanced draw per range
+    // and level of detail to the frame's render queue. Makes no GL calls so it can run in a
+    // JobSystem job, upload() has to run on the GL thread before the queue is submitted
+    void build(RenderQueue& queue) {
+        const std::vector<MaterialRange>& ranges = instances[0]->getRanges();
+        int levels = geometry.lodCount;
+        int n = instances.size();
+
+        // Gather the matrices and layers of every instance that wasn't culled into its level's slots,
+        // sort each level by its closest instance
+        std::fill(lodVisible.begin(), lodVisible.end(), 0);
+        std::fill(lodDepth.begin(), lodDepth.end(), INFINITY);
+        int visible = 0;
+        for (int i = 0; i < n; i++) {
+            if (!instances[i]->isVisible()) {
+                continue;
+            }
+            int l = instances[i]->updateLod();
+            int k = lodVisible[l]++;
+            data[l * n + k].model = instances[i]->getMesh() * geometry.dequant;
+            data[l * n + k].normMat = instances[i]->getNormal();
+            for (int r = 0; r < ranges.size(); r++) {
+                layers[(l * ranges.size() + r) * n + k] = instances[i]->getRanges()[r].texture->layerAttrib();
+            }
+            lodDepth[l] = std::min(lodDepth[l], instances[i]->viewDepth());
+            visible++;
+        }
+        uploadPending = visible > 0;
+
+        // One instanced packet per texture range at each level in use, every instance's texture for it is in the same array
+        for (int l = 0; l < levels; l++) {
+            if (lodVisible[l] == 0) {
+                continue;
+            }
+            for (int r = 0; r < ranges.size(); r++) {
+                DrawPacket p{};
+                p.shader = &shader;
+                p.texture = ranges[r].texture->id;
+                p.vao = vaos[l * ranges.size() + r];
+                p.geometry = &geometry;
+                p.range = &ranges[r].lods[l];
+                p.instances = lodVisible[l];
+                p.lod = l;
+                p.key = RenderQueue::makeKey(shader.id, p.texture, p.vao, lodDepth[l]);
+                queue.push(p);
+            }
+        }
+    }
+
+    // Orphan and refill the instance and layer buffers with what the last build() gathered
+    void upload() {
+        if (!uploadPending) {
+            return;
+        }
+        uploadPending = false;
+
+        GLState::get().bindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+        glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, data.size() * sizeof(InstanceData), data.data());
+
+        GLState::get().bindBuffer(GL_ARRAY_BUFFER, layerVbo);
+        glBufferData(GL_ARRAY_BUFFER, layers.size() * sizeof(glm::vec3), NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, layers.size() * sizeof(glm::vec3), layers.data());
+    }
+
+    // Number of meshes in the group
+    int count() const { return instances.size(); }
+
+    // Meshes in the group
+    const std::vector<Mesh*>& getInstances() const { return instances; }
+};
+
+
+// What decides if two meshes can be drawn as instances of each other: their Geometry,
+// Shader, and for each material slot the texture array it's in and which range it's drawn in
+using InstanceKey = std::tuple<Geometry*, Shader*, std::vector<std::pair<unsigned int, int>>>;
+
+InstanceKey instanceKey(Mesh* m) {
+    const std::vector<Texture*>& materials = m->getMaterials();
+    std::vector<std::pair<unsigned int, int>> slots;
+    for (int i = 0; i < materials.size(); i++) {
+
+        // Slots sharing a texture share a range, so the first slot with that texture identifies the range
+        int range = std::find(materials.begin(), materials.end(), materials[i]) - materials.begin();
+        slots.emplace_back(materials[i]->id, range);
+    }
+    return std::make_tuple(&m->getGeometry(), &m->getShader(), slots);
+}
+
+// Move every set of 2 or more meshes that share Geometry, Shader, and texture arrays
+// out of meshes and into an InstanceGroup. Meshes left over keep their order.
+// Textures must already be packed by TextureArrays
+std::vector<std::unique_ptr<InstanceGroup>> makeInstanceGroups(std::vector<Mesh*>& meshes) {
+
+    // Bucket the meshes by what they draw with, in first seen order
+    std::map<InstanceKey, int> bucketIndex;
+    std::vector<std::vector<Mesh*>> buckets;
+    for (auto m : meshes) {
+        auto key = instanceKey(m);
+        auto it = bucketIndex.find(key);
+        if (it == bucketIndex.end()) {
+            it = bucketIndex.emplace(key, buckets.size()).first;
+            buckets.emplace_back();
+        }
+        buckets[it->second].push_back(m);
+    }
+
+    // Turn buckets with more than one mesh into groups, the rest go back into meshes
+    std::vector<std::unique_ptr<InstanceGroup>> groups;
+    std::vector<Mesh*> single;
+    for (auto& b : buckets) {
+        if (b.size() > 1) {
+            groups.push_back(std::make_unique<InstanceGroup>(b));
+        }
+    }
+    for (auto m : meshes) {
+        if (buckets[bucketIndex[instanceKey(m)]].size() == 1) {
+            single.push_back(m);
+        }
+    }
+    meshes = single;
+
+    return groups;
+}
+
+
+#endif
@@ -0,0 +1,194 @@
+#ifndef JOBSYSTEM_
+#define JOBSYSTEM_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Work stealing job system for building each frame's draws.
+// Every thread has its own queue, it runs its newest job first and when it runs out it
+// steals the oldest job from another thread's queue. The thread that made the JobSystem
+// (the GL thread) is thread 0 and helps run jobs while it waits, workers are 1 and up.
+// Like ThreadPool, jobs must not touch GL
+class JobSystem {
+
+public:
+
+    // Counts since the last beginFrame()
+    struct Stats {
+        int threads = 0;
+        int jobs = 0;
+        int stolen = 0;         // jobs run by a thread other than the one that queued them
+    };
+
+private:
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> jobs;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+
+    // Jobs sitting in a queue, and jobs queued or running
+    std::atomic<int> queued{ 0 };
+    std::atomic<int> pending{ 0 };
+    std::atomic<bool> stopping{ false };
+
+    // Idle workers sleep on this until something is queued
+    std::mutex sleepMutex;
+    std::condition_variable jobAdded;
+
+    std::atomic<int> jobCount{ 0 };
+    std::atomic<int> stolenCount{ 0 };
+
+    // Run one job, from self's queue if it has any or stolen from another, returns false if there were none
+    bool runOne(int self) {
+        std::function<void()> job;
+        bool stolen = false;
+        {
+            Queue& q = *queues[self];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (!q.jobs.empty()) {
+                job = std::move(q.jobs.back());
+                q.jobs.pop_back();
+            }
+        }
+        for (int i = 1; i < queues.size() && !job; i++) {
+            Queue& q = *queues[(self + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (!q.jobs.empty()) {
+                job = std::move(q.jobs.front());
+                q.jobs.pop_front();
+                stolen = true;
+            }
+        }
+        if (!job) {
+            return false;
+        }
+
+        queued--;
+        job();
+        jobCount++;
+        stolenCount += stolen;
+        pending--;
+        return true;
+    }
+
+    void work(int self) {
+        threadIndex() = self;
+        while (!stopping) {
+            if (runOne(self)) {
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            jobAdded.wait(lock, [this] { return stopping || queued > 0; });
+        }
+    }
+
+public:
+
+    // Start workers threads, 0 uses one per hardware thread besides this one
+    JobSystem(int threads = 0) {
+        if (threads <= 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency()) - 1;
+        }
+        for (int i = 0; i <= threads; i++) {
+            queues.push_back(std::make_unique<Queue>());
+        }
+        for (int i = 1; i <= threads; i++) {
+            workers.emplace_back([this, i] { work(i); });
+        }
+    }
+
+    ~JobSystem() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        jobAdded.notify_all();
+        for (auto& t : workers) {
+            t.join();
+        }
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Index of the calling thread, 0 for the GL thread (and any thread not in a JobSystem)
+    static int& threadIndex() {
+        static thread_local int index = 0;
+        return index;
+    }
+
+    // Queue a job on the calling thread's queue
+    void submit(std::function<void()> job) {
+
+        // Counted before it's queued, a worker could steal and finish it before this returns
+        pending++;
+        queued++;
+        {
+            Queue& q = *queues[threadIndex()];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            q.jobs.push_back(std::move(job));
+        }
+
+        // Taking the lock makes sure a worker about to sleep sees queued first
+        { std::lock_guard<std::mutex> lock(sleepMutex); }
+        jobAdded.notify_one();
+    }
+
+    // Queue fn(begin, end) over [0, count) in chunks of grain
+    void dispatch(int count, int grain, const std::function<void(int, int)>& fn) {
+        grain = std::max(grain, 1);
+        for (int begin = 0; begin < count; begin += grain) {
+            int end = std::min(begin + grain, count);
+            submit([fn, begin, end] { fn(begin, end); });
+        }
+    }
+
+    // Run jobs on this thread until every queued job has finished
+    void wait() {
+        int self = threadIndex();
+        while (pending > 0) {
+            if (!runOne(self)) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // Reset the stats, once per frame
+    void beginFrame() {
+        jobCount = 0;
+        stolenCount = 0;
+    }
+
+    // Threads that run jobs, this one included
+    int size() const { return queues.size(); }
+
+    Stats getStats() const {
+        Stats s;
+        s.threads = queues.size();
+        s.jobs = jobCount;
+        s.stolen = stolenCount;
+        return s;
+    }
+};
+
+// toString for JobSystem::Stats
+std::ostream& operator<<(std::ostream& os, const JobSystem::Stats& s) {
+    os << "Job threads: " << s.threads << ", Jobs: " << s.jobs << ", Stolen: " << s.stolen;
+    return os;
+}
+
+
+#endif
@@ -1,6 +1,8 @@
 #ifndef LIGHTSOURCE
 #define LIGHTSOURCE
 
+#include <algorithm>
+#include <cmath>
 #include <vector>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -35,6 +37,21 @@ public:
 
 };
 
+// Distance past which l adds less than 1/256 to a white surface, 0 if it's off.
+// The most it can add at distance d is (aStr + dStr + sStr) * color / attenuation(d)
+inline float lightRadius(const Light& l) {
+	glm::vec3 c = glm::abs(l.lightColor);
+	float peak = std::max(c.x, std::max(c.y, c.z)) * (l.aStr + l.dStr + l.sStr);
+	float k = peak * 256.0f - l.constant;
+	if (peak <= 0.0f || k <= 0.0f) {
+		return 0.0f;
+	}
+	if (l.quadratic > 0.0f) {
+		return (-l.linear + std::sqrt(l.linear * l.linear + 4.0f * l.quadratic * k)) / (2.0f * l.quadratic);
+	}
+	return l.linear > 0.0f ? k / l.linear : INFINITY;
+}
+
 // toString for Light
 std::ostream& operator<<(std::ostream& os, Light& l) {
 	std::cout << "Light:" << std::endl;
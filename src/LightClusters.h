@@ -0,0 +1,283 @@
+#ifndef LIGHTCLUSTERS_
+#define LIGHTCLUSTERS_
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Camera.h"
+#include "Frustum.h"
+#include "GLState.h"
+#include "Light.h"
+#include "JobSystem.h"
+#include "Shader.h"
+
+// Texture units the light buffers are bound to, after the G-buffer's (see DeferredRenderer.h)
+constexpr int LIGHT_DATA_UNIT = 4;
+constexpr int CLUSTER_UNIT = 5;
+constexpr int LIGHT_INDEX_UNIT = 6;
+
+// Clusters across the screen, and depth slices between the near and far planes
+constexpr int CLUSTERS_X = 16;
+constexpr int CLUSTERS_Y = 9;
+constexpr int CLUSTERS_Z = 24;
+
+
+// Clustered light culling. The view frustum is split into a grid of clusters,
+// screen tiles across and exponentially spaced depth slices, and every light
+// is binned into the clusters its attenuation radius reaches. The shaders
+// then only loop over the lights in the cluster a fragment falls in.
+// Lights, per-cluster (offset, count), and the light index lists each live in a
+// texture buffer, so there's no limit on lights besides memory.
+// Binning is split across JobSystem jobs by depth slice, slices never share a cluster
+class LightClusters {
+
+public:
+
+    // Counts from the last update()
+    struct Stats {
+        int lights = 0;
+        int binned = 0;         // lights that reach into the view frustum
+        int indices = 0;        // entries in every cluster's list together
+        int maxPerCluster = 0;
+    };
+
+private:
+
+    // Light, as the view space sphere it reaches and the slices it covers
+    struct Bin {
+        glm::vec3 center;
+        float radius;
+        int slice0, slice1;
+    };
+
+    // Size of the framebuffer being lit, the shaders find their tile from gl_FragCoord
+    int width = 1, height = 1;
+
+    // Projection the cluster bounds were built for
+    glm::mat4 proj{ 0.0f };
+    float zNear = 0.0f, zFar = 0.0f;
+    float sliceScale = 0.0f, sliceBias = 0.0f;
+
+    // View space bounds of each cluster, and the distance each slice starts at (CLUSTERS_Z + 1 of them)
+    std::vector<AABB> clusterBounds;
+    std::vector<float> sliceDist;
+
+    std::vector<Bin> bins;
+    std::vector<int> binned;
+    std::vector<std::vector<uint32_t>> clusterLights;
+
+    // CPU copies of the texture buffers
+    std::vector<glm::vec4> lightData;       // 3 texels per light, see fetchLight() in fragmentShader
+    std::vector<GLuint> clusterTable;       // offset, count per cluster
+    std::vector<GLuint> indices;
+
+    GLuint lightBuffer{}, lightTex{};
+    GLuint clusterBuffer{}, clusterTex{};
+    GLuint indexBuffer{}, indexTex{};
+
+    Stats stats;
+
+    static int clusterIndex(int x, int y, int z) {
+        return (z * CLUSTERS_Y + y) * CLUSTERS_X + x;
+    }
+
+    int sliceOf(float dist) const {
+        int s = (int)std::floor(std::log(std::max(dist, zNear)) * sliceScale + sliceBias);
+        return std::min(std::max(s, 0), CLUSTERS_Z - 1);
+    }
+
+    // Buffer and the buffer texture reading it as format, bound on unit
+    void makeBuffer(GLuint& buffer, GLuint& tex, GLenum format, int unit) {
+        glGenBuffers(1, &buffer);
+        GLState::get().bindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+        glGenTextures(1, &tex);
+        GLState::get().bindTexture(unit, GL_TEXTURE_BUFFER, tex);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+    }
+
+    // Orphan buffer and fill it with bytes from data, never empty since GL won't take a 0 size buffer
+    void upload(GLuint buffer, const void* data, size_t bytes) {
+        GLState::get().bindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, std::max(bytes, (size_t)16), NULL, GL_STREAM_DRAW);
+        if (bytes > 0) {
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+        }
+    }
+
+    // Work out the slices and each cluster's view space box for the camera's projection.
+    // Assumes a symmetric perspective projection, like glm::perspective gives
+    void buildClusters(Camera& c) {
+        proj = c.getProj();
+        zNear = c.getNear();
+        zFar = c.getFar();
+        sliceScale = CLUSTERS_Z / std::log(zFar / zNear);
+        sliceBias = -CLUSTERS_Z * std::log(zNear) / std::log(zFar / zNear);
+
+        sliceDist.resize(CLUSTERS_Z + 1);
+        for (int z = 0; z <= CLUSTERS_Z; z++) {
+            sliceDist[z] = zNear * std::pow(zFar / zNear, (float)z / CLUSTERS_Z);
+        }
+
+        // A point at ndc x and distance d is at view x = ndc * d / proj[0][0]
+        clusterBounds.resize(CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z);
+        for (int z = 0; z < CLUSTERS_Z; z++) {
+            float d0 = sliceDist[z], d1 = sliceDist[z + 1];
+            for (int y = 0; y < CLUSTERS_Y; y++) {
+                float ny0 = 2.0f * y / CLUSTERS_Y - 1.0f, ny1 = 2.0f * (y + 1) / CLUSTERS_Y - 1.0f;
+                for (int x = 0; x < CLUSTERS_X; x++) {
+                    float nx0 = 2.0f * x / CLUSTERS_X - 1.0f, nx1 = 2.0f * (x + 1) / CLUSTERS_X - 1.0f;
+                    AABB& b = clusterBounds[clusterIndex(x, y, z)];
+                    b.min = glm::vec3(std::min(nx0 * d0, nx0 * d1) / proj[0][0], std::min(ny0 * d0, ny0 * d1) / proj[1][1], -d1);
+                    b.max = glm::vec3(std::max(nx1 * d0, nx1 * d1) / proj[0][0], std::max(ny1 * d0, ny1 * d1) / proj[1][1], -d0);
+                }
+            }
+        }
+    }
+
+    // Tiles along one axis the view space range [lo, hi] can land on, between distances d0 and d1
+    static void tileRange(float lo, float hi, float d0, float d1, float scale, int tiles, int& first, int& last) {
+        float ndcLo = scale * std::min(lo / d0, lo / d1);
+        float ndcHi = scale * std::max(hi / d0, hi / d1);
+        first = std::max(0, (int)std::floor((ndcLo * 0.5f + 0.5f) * tiles));
+        last = std::min(tiles - 1, (int)std::floor((ndcHi * 0.5f + 0.5f) * tiles));
+    }
+
+    // Bin every light into the clusters of slice z
+    void binSlice(int z) {
+        for (int i : binned) {
+            const Bin& b = bins[i];
+            if (z < b.slice0 || z > b.slice1) {
+                continue;
+            }
+
+            // The sphere's box, cut down to this slice
+            float d0 = std::max(sliceDist[z], -b.center.z - b.radius);
+            float d1 = std::min(sliceDist[z + 1], -b.center.z + b.radius);
+            d0 = std::max(d0, zNear);
+            d1 = std::max(d1, d0);
+
+            int x0, x1, y0, y1;
+            tileRange(b.center.x - b.radius, b.center.x + b.radius, d0, d1, proj[0][0], CLUSTERS_X, x0, x1);
+            tileRange(b.center.y - b.radius, b.center.y + b.radius, d0, d1, proj[1][1], CLUSTERS_Y, y0, y1);
+
+            for (int y = y0; y <= y1; y++) {
+                for (int x = x0; x <= x1; x++) {
+                    int cluster = clusterIndex(x, y, z);
+                    const AABB& box = clusterBounds[cluster];
+                    glm::vec3 closest = glm::clamp(b.center, box.min, box.max);
+                    glm::vec3 d = closest - b.center;
+                    if (glm::dot(d, d) <= b.radius * b.radius) {
+                        clusterLights[cluster].push_back(i);
+                    }
+                }
+            }
+        }
+    }
+
+public:
+
+    LightClusters() {
+        makeBuffer(lightBuffer, lightTex, GL_RGBA32F, LIGHT_DATA_UNIT);
+        makeBuffer(clusterBuffer, clusterTex, GL_RG32UI, CLUSTER_UNIT);
+        makeBuffer(indexBuffer, indexTex, GL_R32UI, LIGHT_INDEX_UNIT);
+        clusterLights.resize(CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z);
+        clusterTable.resize(2 * clusterLights.size());
+    }
+
+    // Point shader's light buffer samplers at their units
+    void attach(Shader& shader) {
+        shader.use();
+        shader.getUniform<int>("lightData").set(LIGHT_DATA_UNIT);
+        shader.getUniform<int>("clusterLights").set(CLUSTER_UNIT);
+        shader.getUniform<int>("lightIndices").set(LIGHT_INDEX_UNIT);
+    }
+
+    // Upload lights and rebuild every cluster's light list for the camera's current view,
+    // lighting a fbWidth x fbHeight framebuffer. Slices are binned as jobs on jobs
+    void update(Camera& c, const std::vector<Light*>& lights, int fbWidth, int fbHeight, JobSystem& jobs) {
+        width = std::max(fbWidth, 1);
+        height = std::max(fbHeight, 1);
+        if (c.getProj() != proj) {
+            buildClusters(c);
+        }
+        stats = Stats{};
+        stats.lights = lights.size();
+
+        // Each light's view space sphere and depth slices, and its 3 texels
+        lightData.resize(3 * lights.size());
+        bins.resize(lights.size());
+        binned.clear();
+        const glm::mat4& view = c.getView();
+        for (int i = 0; i < lights.size(); i++) {
+            const Light& l = *lights[i];
+            lightData[3 * i + 0] = glm::vec4(l.lightPos, l.aStr);
+            lightData[3 * i + 1] = glm::vec4(l.lightColor, l.dStr);
+            lightData[3 * i + 2] = glm::vec4(l.sStr, l.constant, l.linear, l.quadratic);
+
+            Bin& b = bins[i];
+            b.center = glm::vec3(view * glm::vec4(l.lightPos, 1.0f));
+            b.radius = std::min(lightRadius(l), 2.0f * zFar);
+            float dist = -b.center.z;
+            if (b.radius <= 0.0f || dist + b.radius < zNear || dist - b.radius > zFar) {
+                continue;
+            }
+            b.slice0 = sliceOf(dist - b.radius);
+            b.slice1 = sliceOf(dist + b.radius);
+            binned.push_back(i);
+        }
+        stats.binned = binned.size();
+
+        for (auto& list : clusterLights) {
+            list.clear();
+        }
+
+        // One job per slice so lights bunched at one depth still spread across threads
+        jobs.dispatch(CLUSTERS_Z, 1, [this](int begin, int end) {
+            for (int z = begin; z < end; z++) {
+                binSlice(z);
+            }
+        });
+        jobs.wait();
+
+        // Flatten the lists into one index buffer
+        indices.clear();
+        for (int i = 0; i < clusterLights.size(); i++) {
+            clusterTable[2 * i] = indices.size();
+            clusterTable[2 * i + 1] = clusterLights[i].size();
+            indices.insert(indices.end(), clusterLights[i].begin(), clusterLights[i].end());
+            stats.maxPerCluster = std::max(stats.maxPerCluster, (int)clusterLights[i].size());
+        }
+        stats.indices = indices.size();
+
+        upload(lightBuffer, lightData.data(), lightData.size() * sizeof(glm::vec4));
+        upload(clusterBuffer, clusterTable.data(), clusterTable.size() * sizeof(GLuint));
+        upload(indexBuffer, indices.data(), indices.size() * sizeof(GLuint));
+
+        GLState& state = GLState::get();
+        state.bindTexture(LIGHT_DATA_UNIT, GL_TEXTURE_BUFFER, lightTex);
+        state.bindTexture(CLUSTER_UNIT, GL_TEXTURE_BUFFER, clusterTex);
+        state.bindTexture(LIGHT_INDEX_UNIT, GL_TEXTURE_BUFFER, indexTex);
+    }
+
+    // Values for the Frame block, clusters along x, y, and z, and
+    // pixels per tile across and up plus the slice scale and bias (slice = log(dist) * scale + bias)
+    glm::vec4 getGrid() const { return glm::vec4(CLUSTERS_X, CLUSTERS_Y, CLUSTERS_Z, 0.0f); }
+    glm::vec4 getParams() const { return glm::vec4((float)width / CLUSTERS_X, (float)height / CLUSTERS_Y, sliceScale, sliceBias); }
+
+    // Get counts from the last update()
+    const Stats& getStats() const { return stats; }
+};
+
+// toString for LightClusters::Stats
+std::ostream& operator<<(std::ostream& os, const LightClusters::Stats& s) {
+    os << "Lights: " << s.lights << ", In view: " << s.binned << ", Cluster entries: " << s.indices << ", Most in a cluster: " << s.maxPerCluster;
+    return os;
+}
+
+
+#endif
@@ -28,19 +28,25 @@ private:
     // ambient, diffuse, and specular lighting
     Light ls;
 
+    // Uniform handle for lightColor in lightShader
+    Uniform<glm::vec4> uLsColor;
+
 
 public:
 
     // LightMesh Constructor
-    LightMesh(Texture& tex, Shader& s, Shader& lsh, Camera& c, std::string path, std::vector<Light*>* lsrc, glm::vec3 lc, float aStr, float dStr, float sStr, float constant, float linear, float quadratic)
-        : Mesh(tex, s, c, path, lsrc), lightShader(lsh) {
+    LightMesh(Texture& tex, Shader& s, Shader& lsh, Camera& c, TransformSystem& t, Geometry& g, glm::vec3 lc, float aStr, float dStr, float sStr, float constant, float linear, float quadratic)
+        : Mesh(tex, s, c, t, g), lightShader(lsh) {
 
         // Create Light object
-        ls = Light(glm::vec3(model * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)), lc, aStr, dStr, sStr, constant, linear, quadratic); 
+        ls = Light(glm::vec3(getMesh() * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)), lc, aStr, dStr, sStr, constant, linear, quadratic); 
         prevColor = lc;
+
+        uLsColor = lightShader.getUniform<glm::vec4>("lightColor");
     }
 
-    void render() {
+    // Add this light's draw to the frame's render queue
+    void draw(RenderQueue& queue) {
 
         // If the light is on, draw Mesh using lsShaders, else use regular shaders
         // Explanation:
@@ -52,36 +58,39 @@ public:
         // But, when the light is off, it should have lighting, so use the draw() function
         // from the base class Mesh to draw so it will use the Shader shaders instead
 
+        if (!visible) {
+            return;
+        }
+
         if (isLightOn) {
-            // Use Associated Shader
-            lightShader.use();
-
-            // Bind model, view, and proj matricies to shader
-            lightShader.setUniformMat4("model", model);
-            lightShader.setUniformMat4("view", camera.getView());
-            lightShader.setUniformMat4("projection", camera.getProj());
-            lightShader.setUniformVec4("lightColor", glm::vec4(ls.lightColor, 1.0f));
-
-            // Bind texture and vao
-            glBindTexture(GL_TEXTURE_2D, texture.id);
-            glBindVertexArray(vao);
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-
-            // Draw elements
-            glDrawElements(GL_TRIANGLES, size, GL_UNSIGNED_INT, 0);
-
-            // Unbind texture and vao
-            glBindTexture(GL_TEXTURE_2D, 0);
-            glBindVertexArray(0);
+            updateRanges();
+            updateLod();
+            float depth = viewDepth();
+            for (auto& r : ranges) {
+                DrawPacket p{};
+                p.shader = &lightShader;
+                p.texture = r.texture->id;
+                p.texLayer = r.texture->layerAttrib();
+                p.vao = geometry.vao;
+                p.geometry = &geometry;
+                p.range = &r.lods[lod];
+                p.lod = lod;
+                p.model = getMesh() * geometry.dequant;
+                p.uColor = uLsColor;
+                p.color = glm::vec4(ls.lightColor, 1.0f);
+                p.key = RenderQueue::makeKey(lightShader.id, p.texture, geometry.vao, depth);
+                queue.push(p);
+            }
         }
         else {
-            Mesh::render(); 
+            Mesh::draw(queue);
         }
     }
 
-    // Update lightPos to new location, always from center of shape
+    // Update lightPos to new location, always from center of shape.
+    // Call after TransformSystem::update() so model is current
     void updateLightPos() {
-        ls.lightPos = (glm::vec3(model * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+        ls.lightPos = (glm::vec3(getMesh() * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)));
     }
 
 
@@ -112,51 +121,6 @@ public:
         isLightOn = !isLightOn;
     }
 
-    // Rotate around point by angle around axis
-    void rotate(glm::vec3 rotPoint, float angle, glm::vec3 axis) {
-
-        // Create translation and inv translation matrix to center of box
-        glm::mat4 tr = glm::translate(glm::mat4(1.0f), rotPoint);
-        glm::mat4 trInv = glm::inverse(tr);
-
-        // Rotation to apply to objects in box
-        glm::mat4 rot = glm::rotate(glm::mat4(1.0f), glm::radians(angle), axis);
-
-        model = tr * rot * trInv * model;
-        updateLightPos();
-    }
-
-    // Rotate around object origin by angle around axis
-    glm::mat4& rotate(float angle, glm::vec3 axis) {
-        model = glm::rotate(model, glm::radians(angle), axis);
-        updateLightPos();
-        return model;
-    }
-
-    // Scale object by vec
-    glm::mat4& scale(glm::vec3 vec) {
-        model = glm::scale(model, vec);
-        updateLightPos();
-        return model;
-    }
-
-    // Translate object by vec
-    glm::mat4& translate(glm::vec3 vec) {
-        glm::mat4 mat = glm::translate(glm::mat4(1.0f), vec);
-        model = mat * model;
-        updateLightPos();
-        return model;
-    }
-
-    // Cycle between rgb
-    void cycleColor(float angle) {
-        updateLightColor(glm::vec3(
-            std::sin(0.3 * glm::radians(std::fmod(angle, 1081)) + 0),
-            std::sin(0.3 * glm::radians(std::fmod(angle, 1081)) + 2),
-            std::sin(0.3 * glm::radians(std::fmod(angle, 1081)) + 4)
-        ));
-    }
-
     // Cycle between on and off
     void cycleStrobe(float angle) {
         updateLightColor(glm::vec3(
@@ -0,0 +1,114 @@
+#ifndef MAPPEDFILE_
+#define MAPPEDFILE_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+// Read-only memory mapping of a whole file, used to read cache files
+// and hash source files without copying them into a buffer first
+class MappedFile {
+
+private:
+    const unsigned char* ptr = nullptr;
+    size_t len = 0;
+
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#endif
+
+public:
+
+    MappedFile(const std::string& path) {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            return;
+        }
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+            return;
+        }
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!mapping) {
+            return;
+        }
+        ptr = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (ptr) {
+            len = (size_t)fileSize.QuadPart;
+        }
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                ptr = (const unsigned char*)p;
+                len = st.st_size;
+            }
+        }
+        // The mapping stays valid after the descriptor is closed
+        close(fd);
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (ptr) UnmapViewOfFile(ptr);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (ptr) munmap((void*)ptr, len);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Check if the file was opened and mapped
+    bool valid() const { return ptr != nullptr; }
+
+    // Getters for the mapped bytes
+    const unsigned char* data() const { return ptr; }
+    size_t size() const { return len; }
+};
+
+
+// 64 bit FNV-1a hash, used to tell if a cache was built from the current source file
+inline uint64_t fnv1a(const void* data, size_t len, uint64_t hash = 14695981039346656037ull) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Hash the contents of the file at path, 0 if it can't be read
+inline uint64_t hashFile(const std::string& path) {
+    MappedFile f(path);
+    return f.valid() ? fnv1a(f.data(), f.size()) : 0;
+}
+
+
+#endif
@@ -1,214 +1,160 @@
 #ifndef OBJECTMESH
 #define OBJECTMESH
 
+#include <algorithm>
 #include <vector>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <tiny_obj_loader.h> 
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
+#include "Geometry.h"
 #include "Texture.h" 
 #include "Shader.h"
 #include "Camera.h"
 #include "Light.h"
+#include "RenderQueue.h"
+#include "TransformSystem.h"
 
 
-// Class for Mesh, this can hold any object to draw to screen,
-// currently only used to hold cubes base on verticies and elements in main
+// Submeshes of a Geometry that are drawn with the same texture,
+// one DrawRange per level of detail with lods[0] the full model
+struct MaterialRange {
+    Texture* texture;
+    std::vector<DrawRange> lods;
+};
+
+
+// Class for Mesh, this is one instance of a model in the scene.
+// The model itself is shared through Geometry, a Mesh only holds
+// where it is (model) and what it's drawn with (texture and shader)
 class Mesh {
 protected:
 
-    // ebo, vao, and vbo
-    unsigned int ebo{};
-    unsigned int vao{};
-    unsigned int vbo{};
-
-    // Holds number of verticies (equal to # of elements in the vector elements)
-    int size{};
+    // Shared vao, vbo, and ebo for the model
+    Geometry& geometry;
 
     // Ref to Texture, Shader, and Camera objects
     Texture& texture;
     Shader& shader;
     Camera& camera;
 
-    // Mesh Matrix and Normal Matrix for this object
-    glm::mat4 model;
-    glm::mat3 normMat;
-
-    // Ref to verticies, elements, and lSources vector arrays
-    std::vector<GLfloat> verticies;
-    std::vector<GLuint> elements;
-    std::vector<Light*>* lSources;
-
-    void setup() {
-        // Creating and binding vao
-        glGenVertexArrays(1, &vao);
-        glBindVertexArray(vao);
-
-        // Creating, generating, binding, and buffering vertex buffer object
-        glGenBuffers(1, &vbo);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, verticies.size() * sizeof(GLfloat), verticies.data(), GL_STATIC_DRAW);
-
-        // Creating, generating, binding, and buffering element buffer object
-        glGenBuffers(1, &ebo);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, elements.size() * sizeof(GLuint), elements.data(), GL_STATIC_DRAW);
-
-        // Setting up attributes
-
-        //position
-        glVertexAttribPointer(
-            0,                                      //attribute of vertex shader
-            3,                                      //number of elements per vertex
-            GL_FLOAT,                               //data type of each element
-            GL_FALSE,                               //take values as is
-            8 * sizeof(GLfloat),                    //next point appears every 5 floats
-            0                                       //offset of the first element
-        );
-        glEnableVertexAttribArray(0);
-
-        //texturePos
-        glVertexAttribPointer(
-            1,                                      //attribute of vertex shader
-            2,                                      //number of elements per vertex
-            GL_FLOAT,                               //data type of each element
-            GL_FALSE,                               //take values as is
-            8 * sizeof(GLfloat),                    //next point appears every 5 floats
-            (void*)(3 * sizeof(GLfloat))            //offset of the first element
-        );
-        glEnableVertexAttribArray(1);
-
-        //normalPos
-        glVertexAttribPointer(
-            2,                                      //attribute of vertex shader
-            3,                                      //number of elements per vertex
-            GL_FLOAT,                               //data type of each element
-            GL_FALSE,                               //take values as is
-            8 * sizeof(GLfloat),                    //next point appears every 5 floats
-            (void*)(5 * sizeof(GLfloat))            //offset of the first element
-        );
-        glEnableVertexAttribArray(2);
-
-        // Unbind vao
-        glBindVertexArray(0);
-    }
-
-public:
-
-    Mesh() = default;
-
-    // Take in texture, shader, verticies, and elements
-    Mesh(Texture& tex, Shader& s, Camera& c, std::string path, std::vector<Light*>* ls)
-        : texture(tex), shader(s), camera(c), lSources(ls){
+    // Texture for each of geometry's material slots, all texture unless set with setMaterial()
+    std::vector<Texture*> materials;
 
-        if (!loadObject(path, verticies, elements)) {
-            std::cout << "Error loading Mesh. Make sure meshes are at ./objects/<model>.obj relative to \"Mesh.h\"" << std::endl;
-            exit(-1);
-        }
+    // Submeshes grouped by the texture they use, one draw packet each.
+    // Built on first use since geometry may still be loading when the Mesh is constructed
+    std::vector<MaterialRange> ranges;
+    bool rangesDirty = true;
 
-        // Set size
-        size = elements.size();
+    // Local, model, and normal matrix for this object live in transforms,
+    // use getLocal() and setMesh() to change it and getMesh() for where it ended up
+    TransformSystem& transforms;
+    int transform;
 
-        // Initialize model to identity
-        model = glm::mat4(1.0f);
-        normMat = glm::mat3(glm::transpose(glm::inverse(model)));
+    // Set by SceneBVH::cull() each frame, draw() skips the mesh when it's false
+    bool visible = true;
 
-        setup();
-    }
+    // Level of detail drawn last, see updateLod()
+    int lod = 0;
 
-    void render() {
-
-        // Use Associated Shader
-        shader.use();
-
-        // Loop over light sources and pass the values to the shaders
-        for (int i = 0; i < lSources->size(); i++) {
-            Light* ls = lSources->at(i);
-            shader.setUniformVec4("l[" + std::to_string(i) + "].lightPos", glm::vec4(ls->lightPos, 1.0f));
-            shader.setUniformVec4("l[" + std::to_string(i) + "].lightCol", glm::vec4(ls->lightColor, 1.0f));
-            shader.setUniformFloat("l[" + std::to_string(i) + "].aStr", ls->aStr);
-            shader.setUniformFloat("l[" + std::to_string(i) + "].dStr", ls->dStr);
-            shader.setUniformFloat("l[" + std::to_string(i) + "].sStr", ls->sStr);
-            shader.setUniformFloat("l[" + std::to_string(i) + "].constant", ls->constant);
-            shader.setUniformFloat("l[" + std::to_string(i) + "].linear", ls->linear);
-            shader.setUniformFloat("l[" + std::to_string(i) + "].quadratic", ls->quadratic);
+    // Rebuild ranges from materials if they changed, slots sharing a texture share a range
+    void updateRanges() {
+        if (!rangesDirty) {
+            return;
         }
+        rangesDirty = false;
 
-        // Update normMat
-        normMat = glm::mat3(glm::transpose(glm::inverse(model)));
-
-        // Bind model, view, and proj matricies to shader
-        shader.setUniformMat4("model", model); 
-        shader.setUniformMat4("view", camera.getView());
-        shader.setUniformMat4("projection", camera.getProj());
-        shader.setUniformVec4("cameraPos", glm::vec4(camera.getPos(), 1.0f));
-        shader.setUniformMat3("normMat", normMat);
-
-        // Bind texture and vao
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture.id);
-        glBindVertexArray(vao);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-
-        // Draw elements
-        glDrawElements(GL_TRIANGLES, size, GL_UNSIGNED_INT, 0);
+        // Slots without a texture set use texture
+        materials.resize(std::max(geometry.materialCount, 1), nullptr);
+        for (auto& m : materials) {
+            if (!m) m = &texture;
+        }
 
-        // Unbind texture and vao
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glBindVertexArray(0);
+        ranges.clear();
+        for (int i = 0; i < materials.size(); i++) {
+            Texture* t = materials[i];
+            bool seen = false;
+            for (auto& r : ranges) {
+                seen = seen || r.texture == t;
+            }
+            if (seen) {
+                continue;
+            }
+
+            std::vector<bool> useMaterial(materials.size());
+            for (int j = i; j < materials.size(); j++) {
+                useMaterial[j] = materials[j] == t;
+            }
+            MaterialRange r{ t, {} };
+            for (int l = 0; l < geometry.lodCount; l++) {
+                r.lods.push_back(geometry.makeRange(useMaterial, l));
+            }
+            ranges.push_back(r);
+        }
     }
 
-    // Loading in the object from a file using Assimp
-    bool loadObject(std::string& path, std::vector<GLfloat>& verticies, std::vector<GLuint>& elements) {
+public:
 
-        Assimp::Importer importer;
+    // Take in texture, shader, camera, transforms, and the model's geometry
+    Mesh(Texture& tex, Shader& s, Camera& c, TransformSystem& t, Geometry& g)
+        : geometry(g), texture(tex), shader(s), camera(c), transforms(t) {
 
-        // Import the scene from the file
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+        // Initialize model to identity
+        transform = transforms.add(glm::mat4(1.0f));
+    }
 
-        // If it failed, return false and escalate the error to the constructor by returning false
-        if (!scene) {
-            std::cout << importer.GetErrorString() << std::endl;
-            return false;
+    // Add this mesh's draw to the frame's render queue, unless it was culled
+    void draw(RenderQueue& queue) {
+        if (!visible) {
+            return;
         }
 
-        // Get the first mesh (and only mesh, my program only supports .obj files that have 1 mesh)
-        const aiMesh* mesh = scene->mMeshes[0];
-
-        // Fill verticies
-        verticies.reserve(mesh->mNumVertices);
-        for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-
-            // Get pos, tex, and norm coordinates
-            aiVector3D pos = mesh->mVertices[i];
-            aiVector3D UVW = mesh->mTextureCoords[0][i];
-            aiVector3D norm = mesh->mNormals[i];
-
-            // Insert coordinates into verticies in the order that matches the glAttribPointers
-            verticies.push_back((GLfloat)pos.x);
-            verticies.push_back((GLfloat)pos.y);
-            verticies.push_back((GLfloat)pos.z);
-            verticies.push_back((GLfloat)UVW.x);
-            verticies.push_back((GLfloat)UVW.y);
-            verticies.push_back((GLfloat)norm.x);
-            verticies.push_back((GLfloat)norm.y);
-            verticies.push_back((GLfloat)norm.z);
+        // One packet per texture, each drawing all the submeshes that use it
+        updateRanges();
+        updateLod();
+        float depth = viewDepth();
+        for (auto& r : ranges) {
+            DrawPacket p{};
+            p.shader = &shader;
+            p.texture = r.texture->id;
+            p.texLayer = r.texture->layerAttrib();
+            p.vao = geometry.vao;
+            p.geometry = &geometry;
+            p.range = &r.lods[lod];
+            p.lod = lod;
+            p.model = getMesh() * geometry.dequant;
+            p.normMat = getNormal();
+            p.key = RenderQueue::makeKey(shader.id, p.texture, geometry.vao, depth);
+            queue.push(p);
         }
+    }
+
+    // Distance in front of the camera of the mesh's origin
+    float viewDepth() {
+        return -(camera.getView() * getMesh()[3]).z;
+    }
 
-        // Fill face indices
-        elements.reserve(3 * mesh->mNumFaces);
-        for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+    // Share of the screen's height the bounding sphere covers, 1 or more when the camera is inside it
+    float screenSize() {
+        const glm::mat4& m = getMesh();
+        glm::vec3 center = glm::vec3(m * glm::vec4((geometry.boundsMin + geometry.boundsMax) * 0.5f, 1.0f));
+        float scale = std::max(glm::length(glm::vec3(m[0])), std::max(glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2]))));
+        float radius = glm::length(geometry.boundsMax - geometry.boundsMin) * 0.5f * scale;
 
-            // Insert elements into element vector
-            elements.push_back(mesh->mFaces[i].mIndices[0]);
-            elements.push_back(mesh->mFaces[i].mIndices[1]);
-            elements.push_back(mesh->mFaces[i].mIndices[2]);
+        float depth = -(camera.getView() * glm::vec4(center, 1.0f)).z;
+        if (depth <= radius) {
+            return 1.0f;
         }
-        return true;
+        return std::min(radius * camera.getProj()[1][1] / depth, 1.0f);
     }
 
+    // Pick the level of detail to draw this frame from screenSize(), see selectLod()
+    int updateLod() {
+        lod = selectLod(lod, screenSize(), geometry.lodCount);
+        return lod;
+    }
+
+    // These all change the local matrix, so they're relative to the parent if there is one
+
     // Rotate around point by angle around axis
     void rotate(glm::vec3 rotPoint, float angle, glm::vec3 axis) {
 
@@ -219,31 +165,66 @@ public:
         // Rotation to apply to objects in box
         glm::mat4 rot = glm::rotate(glm::mat4(1.0f), glm::radians(angle), axis);
 
-        model = tr * rot * trInv * model;
+        setMesh(tr * rot * trInv * getLocal());
     }
 
     // Rotate around object origin by angle around axis
-    glm::mat4& rotate(float angle, glm::vec3 axis) {
-        model = glm::rotate(model, glm::radians(angle), axis);
-        return model;
+    const glm::mat4& rotate(float angle, glm::vec3 axis) {
+        setMesh(glm::rotate(getLocal(), glm::radians(angle), axis));
+        return getLocal();
     }
 
     // Scale object by vec
-    glm::mat4& scale(glm::vec3 vec) {
-        model = glm::scale(model, vec);
-        return model;
+    const glm::mat4& scale(glm::vec3 vec) {
+        setMesh(glm::scale(getLocal(), vec));
+        return getLocal();
     }
 
     // Translate object by vec
-    glm::mat4& translate(glm::vec3 vec) {
+    const glm::mat4& translate(glm::vec3 vec) {
         glm::mat4 mat = glm::translate(glm::mat4(1.0f), vec);
-        model = mat * model;
-        return model;
+        setMesh(mat * getLocal());
+        return getLocal();
+    }
+
+    // Use tex for every submesh in geometry's material slot
+    void setMaterial(int slot, Texture& tex) {
+        if (slot < 0) {
+            return;
+        }
+        if (slot >= materials.size()) {
+            materials.resize(slot + 1, nullptr);
+        }
+        materials[slot] = &tex;
+        rangesDirty = true;
     }
 
-    // Setter and Getter for model
-    glm::mat4& getMesh() { return model; }
-    void setMesh(glm::mat4) { this->model = model; }
+    // Getters for what the mesh is drawn with
+    Geometry& getGeometry() { return geometry; }
+    Texture& getTexture() { return texture; }
+    Shader& getShader() { return shader; }
+    const std::vector<Texture*>& getMaterials() { updateRanges(); return materials; }
+    const std::vector<MaterialRange>& getRanges() { updateRanges(); return ranges; }
+
+    // Setter and Getter for visible
+    void setVisible(bool v) { visible = v; }
+    bool isVisible() const { return visible; }
+
+    // Getter for model (world matrix), as of the last TransformSystem::update()
+    const glm::mat4& getMesh() const { return transforms.getModel(transform); }
+
+    // Setter and Getter for the local matrix, setting it marks the transform dirty
+    void setMesh(const glm::mat4& m) { transforms.set(transform, m); }
+    const glm::mat4& getLocal() const { return transforms.getLocal(transform); }
+
+    // Normal matrix, updated from model by TransformSystem::update()
+    const glm::mat3& getNormal() const { return transforms.getNormal(transform); }
+
+    // Index of this mesh's transform in transforms
+    int getTransform() const { return transform; }
+
+    // Attach this mesh under parent, its local matrix is then relative to parent's model
+    void setParent(Mesh& parent) { transforms.setParent(transform, parent.transform); }
 };
 
 
@@ -0,0 +1,156 @@
+#ifndef MESHCACHE_
+#define MESHCACHE_
+
+#include <GL/glew.h>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+
+
+// One mesh inside a model file. Its elements are
+// [firstIndex, firstIndex + indexCount) in the shared ebo and are
+// relative to baseVertex in the shared vbo
+struct Submesh {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    int32_t baseVertex;
+    uint32_t material;          // Material slot, dense from 0
+};
+
+// Header at the start of a .bin mesh cache file. It's followed by the
+// interleaved vertex blob (8 floats per vertex, same layout as the vbo),
+// the index blob (one GLuint per element, every level of detail), and the Submesh table
+// (submeshCount per level, level by level)
+struct MeshCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceHash;        // fnv1a of the .obj it was built from
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t submeshCount;
+    uint32_t materialCount;
+    uint32_t lodCount;
+    float boundsMin[3];
+    float boundsMax[3];
+};
+
+constexpr char MESH_CACHE_MAGIC[4] = { 'M', 'S', 'H', 'C' };
+constexpr uint32_t MESH_CACHE_VERSION = 3;
+
+
+// Preprocessed copy of an .obj stored next to it as <path>.bin, so later runs
+// can skip Assimp and upload the mapped blobs straight to the vbo and ebo
+class MeshCache {
+
+private:
+    MappedFile file;
+    const MeshCacheHeader* header = nullptr;
+
+public:
+
+    // Path of the cache file for the .obj at path
+    static std::string cachePath(const std::string& path) {
+        return path + ".bin";
+    }
+
+    // Map the cache for the .obj at path, only valid if it was built from a source with sourceHash
+    MeshCache(const std::string& path, uint64_t sourceHash) : file(cachePath(path)) {
+
+        if (!file.valid() || file.size() < sizeof(MeshCacheHeader)) {
+            return;
+        }
+
+        const MeshCacheHeader* h = (const MeshCacheHeader*)file.data();
+        if (std::memcmp(h->magic, MESH_CACHE_MAGIC, 4) != 0 || h->version != MESH_CACHE_VERSION || h->sourceHash != sourceHash || h->lodCount == 0) {
+            return;
+        }
+
+        // Make sure the file holds everything the header says it does
+        size_t expected = sizeof(MeshCacheHeader) + verticiesSize(*h) + elementsSize(*h) + submeshesSize(*h);
+        if (file.size() < expected) {
+            return;
+        }
+
+        header = h;
+    }
+
+    // Check if the cache exists, is up to date, and is complete
+    bool valid() const { return header != nullptr; }
+
+    // Getters for the header and the mapped blobs
+    const MeshCacheHeader& getHeader() const { return *header; }
+
+    const GLfloat* verticies() const {
+        return (const GLfloat*)(file.data() + sizeof(MeshCacheHeader));
+    }
+
+    const GLuint* elements() const {
+        return (const GLuint*)(file.data() + sizeof(MeshCacheHeader) + verticiesSize(*header));
+    }
+
+    const Submesh* submeshes() const {
+        return (const Submesh*)(file.data() + sizeof(MeshCacheHeader) + verticiesSize(*header) + elementsSize(*header));
+    }
+
+    // Size in bytes of the vertex, index, and submesh blobs
+    static size_t verticiesSize(const MeshCacheHeader& h) { return (size_t)h.vertexCount * 8 * sizeof(GLfloat); }
+    static size_t elementsSize(const MeshCacheHeader& h) { return (size_t)h.indexCount * sizeof(GLuint); }
+    static size_t submeshesSize(const MeshCacheHeader& h) { return (size_t)h.submeshCount * h.lodCount * sizeof(Submesh); }
+
+    // Write a cache for the .obj at path, returns false if the file can't be written.
+    // submeshes holds lodCount levels one after the other
+    static bool write(const std::string& path, uint64_t sourceHash, const std::vector<GLfloat>& verticies,
+                      const std::vector<GLuint>& elements, const std::vector<Submesh>& submeshes, uint32_t materialCount,
+                      uint32_t lodCount, const float boundsMin[3], const float boundsMax[3]) {
+
+        MeshCacheHeader h{};
+        std::memcpy(h.magic, MESH_CACHE_MAGIC, 4);
+        h.version = MESH_CACHE_VERSION;
+        h.sourceHash = sourceHash;
+        h.vertexCount = verticies.size() / 8;
+        h.indexCount = elements.size();
+        h.submeshCount = submeshes.size() / lodCount;
+        h.materialCount = materialCount;
+        h.lodCount = lodCount;
+        std::memcpy(h.boundsMin, boundsMin, sizeof(h.boundsMin));
+        std::memcpy(h.boundsMax, boundsMax, sizeof(h.boundsMax));
+
+        // Write to a temp file first so a half-written cache is never picked up.
+        // Float and Compact Geometry of the same .obj can both write it at once from
+        // different loader threads, so each write gets its own temp file
+        static std::atomic<int> writes{ 0 };
+        std::string tmp = cachePath(path) + "." + std::to_string(writes++) + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            if (!out) {
+                return false;
+            }
+            out.write((const char*)&h, sizeof(h));
+            out.write((const char*)verticies.data(), verticiesSize(h));
+            out.write((const char*)elements.data(), elementsSize(h));
+            out.write((const char*)submeshes.data(), submeshesSize(h));
+            if (!out) {
+                out.close();
+                std::remove(tmp.c_str());
+                return false;
+            }
+        }
+
+        // Both writers have the same contents so it doesn't matter whose cache stays. The rename can
+        // fail on Windows if the other one's landed since the remove, that still leaves a cache
+        std::remove(cachePath(path).c_str());
+        if (std::rename(tmp.c_str(), cachePath(path).c_str()) != 0) {
+            std::remove(tmp.c_str());
+            return std::ifstream(cachePath(path)).good();
+        }
+        return true;
+    }
+};
+
+
+#endif
@@ -0,0 +1,275 @@
+#ifndef MIPCHAIN_
+#define MIPCHAIN_
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+
+// Layout of the levels in a MipChain
+//   RGBA8: 4 bytes per pixel, uploaded with glTexImage2D
+//   BC1:   8 bytes per 4x4 block, opaque images (DXT1)
+//   BC3:   16 bytes per 4x4 block, images with alpha (DXT5)
+enum class MipFormat : uint32_t {
+    RGBA8 = 0,
+    BC1 = 1,
+    BC3 = 2
+};
+
+// One level of a MipChain, offset and size are into MipChain::data
+struct MipLevel {
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset;
+    uint64_t size;
+};
+
+// Every level of a texture from full size down to 1x1, packed back to back
+struct MipChain {
+    MipFormat format = MipFormat::RGBA8;
+    float uvScale[2] = { 1.0f, 1.0f };      // Part of level 0 the image covers, see padToPowerOfTwo()
+    std::vector<MipLevel> levels;
+    std::vector<unsigned char> data;
+};
+
+
+// Size in bytes of one w x h level in format
+inline size_t mipLevelSize(MipFormat format, uint32_t w, uint32_t h) {
+    if (format == MipFormat::RGBA8) {
+        return (size_t)w * h * 4;
+    }
+    size_t blocks = (size_t)std::max(1u, (w + 3) / 4) * std::max(1u, (h + 3) / 4);
+    return blocks * (format == MipFormat::BC1 ? 8 : 16);
+}
+
+// GL internal format for a compressed MipFormat
+inline GLenum mipGLFormat(MipFormat format) {
+    return format == MipFormat::BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+}
+
+
+// Expand stbi output with 1 to 4 channels to RGBA
+inline std::vector<unsigned char> toRGBA(const unsigned char* src, int w, int h, int channels) {
+    std::vector<unsigned char> out((size_t)w * h * 4);
+    for (size_t i = 0; i < (size_t)w * h; i++) {
+        const unsigned char* s = src + i * channels;
+        unsigned char* d = out.data() + i * 4;
+        switch (channels) {
+        case 1: d[0] = d[1] = d[2] = s[0]; d[3] = 255; break;
+        case 2: d[0] = d[1] = d[2] = s[0]; d[3] = s[1]; break;
+        case 3: d[0] = s[0]; d[1] = s[1]; d[2] = s[2]; d[3] = 255; break;
+        default: std::memcpy(d, s, 4); break;
+        }
+    }
+    return out;
+}
+
+// Grow an RGBA image to the next power of two on each side so it fits a
+// texture array layer, the new pixels repeat the last row/column so
+// filtering at the image's edge doesn't pick up anything else
+inline std::vector<unsigned char> padToPowerOfTwo(const std::vector<unsigned char>& src, uint32_t w, uint32_t h, uint32_t& outW, uint32_t& outH) {
+    outW = 1;
+    outH = 1;
+    while (outW < w) outW *= 2;
+    while (outH < h) outH *= 2;
+    if (outW == w && outH == h) {
+        return src;
+    }
+
+    std::vector<unsigned char> out((size_t)outW * outH * 4);
+    for (uint32_t y = 0; y < outH; y++) {
+        const unsigned char* row = src.data() + (size_t)std::min(y, h - 1) * w * 4;
+        unsigned char* d = out.data() + (size_t)y * outW * 4;
+        std::memcpy(d, row, (size_t)w * 4);
+        for (uint32_t x = w; x < outW; x++) {
+            std::memcpy(d + (size_t)x * 4, row + (size_t)(w - 1) * 4, 4);
+        }
+    }
+    return out;
+}
+
+// Halve an RGBA image with a box filter, odd edges reuse the last row/column
+inline std::vector<unsigned char> downsample(const std::vector<unsigned char>& src, uint32_t w, uint32_t h, uint32_t& outW, uint32_t& outH) {
+    outW = std::max(1u, w / 2);
+    outH = std::max(1u, h / 2);
+    std::vector<unsigned char> out((size_t)outW * outH * 4);
+
+    for (uint32_t y = 0; y < outH; y++) {
+        uint32_t y0 = std::min(2 * y, h - 1), y1 = std::min(2 * y + 1, h - 1);
+        for (uint32_t x = 0; x < outW; x++) {
+            uint32_t x0 = std::min(2 * x, w - 1), x1 = std::min(2 * x + 1, w - 1);
+            for (int c = 0; c < 4; c++) {
+                unsigned sum = src[((size_t)y0 * w + x0) * 4 + c] + src[((size_t)y0 * w + x1) * 4 + c]
+                             + src[((size_t)y1 * w + x0) * 4 + c] + src[((size_t)y1 * w + x1) * 4 + c];
+                out[((size_t)y * outW + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+    return out;
+}
+
+
+// Pack and unpack 5:6:5 colors
+inline uint16_t to565(const unsigned char* c) {
+    return (uint16_t)(((c[0] * 31 + 127) / 255) << 11 | ((c[1] * 63 + 127) / 255) << 5 | ((c[2] * 31 + 127) / 255));
+}
+
+inline void from565(uint16_t v, int* c) {
+    int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+    c[0] = (r << 3) | (r >> 2);
+    c[1] = (g << 2) | (g >> 4);
+    c[2] = (b << 3) | (b >> 2);
+}
+
+// Encode the color half of a BC1/BC3 block from 16 RGBA pixels.
+// Endpoints are the corners of the block's color bounding box pulled in slightly,
+// each pixel then takes the closest of the 4 palette colors
+inline void encodeColorBlock(const unsigned char* px, unsigned char* out) {
+    int lo[3] = { 255, 255, 255 }, hi[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 3; c++) {
+            lo[c] = std::min(lo[c], (int)px[i * 4 + c]);
+            hi[c] = std::max(hi[c], (int)px[i * 4 + c]);
+        }
+    }
+
+    // Inset by 1/16 of the range, cuts the error from the endpoints landing on outliers
+    unsigned char e0[3], e1[3];
+    for (int c = 0; c < 3; c++) {
+        int inset = (hi[c] - lo[c]) >> 4;
+        e0[c] = (unsigned char)(hi[c] - inset);
+        e1[c] = (unsigned char)(lo[c] + inset);
+    }
+
+    uint16_t c0 = to565(e0), c1 = to565(e1);
+    if (c0 < c1) {
+        std::swap(c0, c1);
+    }
+
+    uint32_t indices = 0;
+    if (c0 != c1) {
+        int p[4][3];
+        from565(c0, p[0]);
+        from565(c1, p[1]);
+        for (int c = 0; c < 3; c++) {
+            p[2][c] = (2 * p[0][c] + p[1][c]) / 3;
+            p[3][c] = (p[0][c] + 2 * p[1][c]) / 3;
+        }
+
+        for (int i = 0; i < 16; i++) {
+            int best = 0, bestDist = INT32_MAX;
+            for (int j = 0; j < 4; j++) {
+                int dr = px[i * 4] - p[j][0], dg = px[i * 4 + 1] - p[j][1], db = px[i * 4 + 2] - p[j][2];
+                int d = dr * dr + dg * dg + db * db;
+                if (d < bestDist) {
+                    bestDist = d;
+                    best = j;
+                }
+            }
+            indices |= (uint32_t)best << (2 * i);
+        }
+    }
+
+    std::memcpy(out, &c0, 2);
+    std::memcpy(out + 2, &c1, 2);
+    std::memcpy(out + 4, &indices, 4);
+}
+
+// Encode the alpha half of a BC3 block, 8 alphas interpolated between the block's min and max
+inline void encodeAlphaBlock(const unsigned char* px, unsigned char* out) {
+    int a0 = 0, a1 = 255;
+    for (int i = 0; i < 16; i++) {
+        a0 = std::max(a0, (int)px[i * 4 + 3]);
+        a1 = std::min(a1, (int)px[i * 4 + 3]);
+    }
+
+    uint64_t indices = 0;
+    if (a0 != a1) {
+        int p[8] = { a0, a1 };
+        for (int j = 1; j < 7; j++) {
+            p[j + 1] = ((7 - j) * a0 + j * a1) / 7;
+        }
+
+        for (int i = 0; i < 16; i++) {
+            int a = px[i * 4 + 3];
+            int best = 0, bestDist = 256;
+            for (int j = 0; j < 8; j++) {
+                int d = std::abs(a - p[j]);
+                if (d < bestDist) {
+                    bestDist = d;
+                    best = j;
+                }
+            }
+            indices |= (uint64_t)best << (3 * i);
+        }
+    }
+
+    out[0] = (unsigned char)a0;
+    out[1] = (unsigned char)a1;
+    for (int i = 0; i < 6; i++) {
+        out[2 + i] = (unsigned char)(indices >> (8 * i));
+    }
+}
+
+// Block compress one RGBA level, blocks hanging off the edge repeat the edge pixels
+inline void compressLevel(const unsigned char* rgba, uint32_t w, uint32_t h, MipFormat format, unsigned char* out) {
+    size_t blockSize = format == MipFormat::BC1 ? 8 : 16;
+    uint32_t bw = std::max(1u, (w + 3) / 4), bh = std::max(1u, (h + 3) / 4);
+
+    unsigned char px[16 * 4];
+    for (uint32_t by = 0; by < bh; by++) {
+        for (uint32_t bx = 0; bx < bw; bx++) {
+            for (int i = 0; i < 16; i++) {
+                uint32_t x = std::min(bx * 4 + (i & 3), w - 1);
+                uint32_t y = std::min(by * 4 + (i >> 2), h - 1);
+                std::memcpy(px + i * 4, rgba + ((size_t)y * w + x) * 4, 4);
+            }
+
+            unsigned char* block = out + ((size_t)by * bw + bx) * blockSize;
+            if (format == MipFormat::BC3) {
+                encodeAlphaBlock(px, block);
+                block += 8;
+            }
+            encodeColorBlock(px, block);
+        }
+    }
+}
+
+
+// Build the full mip chain for an RGBA image. compress picks BC1 or BC3
+// depending on whether the image uses alpha, otherwise levels stay RGBA8
+inline MipChain buildMipChain(std::vector<unsigned char> rgba, uint32_t w, uint32_t h, bool compress) {
+    MipChain chain;
+    if (compress) {
+        bool opaque = true;
+        for (size_t i = 3; i < rgba.size() && opaque; i += 4) {
+            opaque = rgba[i] == 255;
+        }
+        chain.format = opaque ? MipFormat::BC1 : MipFormat::BC3;
+    }
+
+    while (true) {
+        MipLevel level{ w, h, chain.data.size(), mipLevelSize(chain.format, w, h) };
+        chain.data.resize(level.offset + level.size);
+
+        if (chain.format == MipFormat::RGBA8) {
+            std::memcpy(chain.data.data() + level.offset, rgba.data(), level.size);
+        }
+        else {
+            compressLevel(rgba.data(), w, h, chain.format, chain.data.data() + level.offset);
+        }
+        chain.levels.push_back(level);
+
+        if (w == 1 && h == 1) {
+            break;
+        }
+        rgba = downsample(rgba, w, h, w, h);
+    }
+    return chain;
+}
+
+
+#endif
@@ -0,0 +1,251 @@
+#ifndef PROFILER_
+#define PROFILER_
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+// CPU and GPU time of named sections of the frame (light pass, mesh pass, swap, ...).
+// CPU time comes from steady_clock, GPU time from a GL_TIME_ELAPSED query around
+// the same section. Each section has RING queries used in turn, and results are only
+// read once GL says they're available, so checking them never waits on the GPU.
+// Sections can't nest on the GPU, a section started inside another only gets CPU time
+class Profiler {
+
+public:
+
+    // Averages over the last WINDOW frames
+    struct SectionStats {
+        std::string name;
+        double cpuMs = 0.0, cpuMaxMs = 0.0;
+        double gpuMs = 0.0, gpuMaxMs = 0.0;
+    };
+
+    struct Stats {
+        int frames = 0;                     // frames in the averages
+        double frameMs = 0.0;               // beginFrame() to beginFrame()
+        int dropped = 0;                    // GPU results still not ready when their query was reused
+        std::vector<SectionStats> sections;
+    };
+
+    // Times everything between its constructor and destructor as section name
+    class Scope {
+    private:
+        Profiler& profiler;
+        int timer;
+    public:
+        Scope(Profiler& profiler, const char* name) : profiler(profiler), timer(profiler.begin(name)) {}
+        ~Scope() { profiler.end(timer); }
+    };
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // Frames of queries in flight per section, and frames in the rolling averages
+    static constexpr int RING = 4;
+    static constexpr int WINDOW = 120;
+
+    // Trace stops recording after this many events (about 25 minutes of frames)
+    static constexpr size_t MAX_TRACE_EVENTS = 500000;
+
+    // Last WINDOW samples of something
+    struct Rolling {
+        std::vector<double> samples;
+        size_t next = 0;
+
+        void add(double v) {
+            if (samples.size() < WINDOW) {
+                samples.push_back(v);
+            }
+            else {
+                samples[next] = v;
+            }
+            next = (next + 1) % WINDOW;
+        }
+        double mean() const {
+            double total = 0.0;
+            for (double v : samples) {
+                total += v;
+            }
+            return samples.empty() ? 0.0 : total / samples.size();
+        }
+        double max() const {
+            return samples.empty() ? 0.0 : *std::max_element(samples.begin(), samples.end());
+        }
+    };
+
+    struct Timer {
+        std::string name;
+        GLuint queries[RING]{};
+        bool pending[RING]{};
+        double startUs[RING]{};     // CPU start of the frame's section, where the GPU event goes in the trace
+        bool queried = false;       // this begin() started a query
+        Clock::time_point start;
+        Rolling cpu, gpu;
+    };
+
+    // One complete event for the Chrome trace, times in microseconds since the Profiler was made
+    struct TraceEvent {
+        int timer;
+        bool gpu;
+        double startUs, durationUs;
+    };
+
+    std::vector<Timer> timers;
+    std::vector<TraceEvent> trace;
+    Clock::time_point epoch = Clock::now();
+    Clock::time_point frameStart;
+    Rolling frameTimes;
+    long long frame = -1;
+    bool queryActive = false;
+    int dropped = 0;
+
+    double sinceEpochUs(Clock::time_point t) const {
+        return std::chrono::duration<double, std::micro>(t - epoch).count();
+    }
+
+    void record(int timer, bool gpu, double startUs, double durationUs) {
+        if (trace.size() < MAX_TRACE_EVENTS) {
+            trace.push_back(TraceEvent{ timer, gpu, startUs, durationUs });
+        }
+    }
+
+    // Read every query that finished, without waiting on any that haven't
+    void collect() {
+        for (int i = 0; i < timers.size(); i++) {
+            Timer& t = timers[i];
+            for (int slot = 0; slot < RING; slot++) {
+                if (!t.pending[slot]) {
+                    continue;
+                }
+                GLint available = 0;
+                glGetQueryObjectiv(t.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+                if (!available) {
+                    continue;
+                }
+                GLuint64 ns = 0;
+                glGetQueryObjectui64v(t.queries[slot], GL_QUERY_RESULT, &ns);
+                t.pending[slot] = false;
+                t.gpu.add(ns / 1.0e6);
+                record(i, true, t.startUs[slot], ns / 1.0e3);
+            }
+        }
+    }
+
+    int slot() const { return frame % RING; }
+
+public:
+
+    // Start a new frame, call once at the top of the loop before any sections
+    void beginFrame() {
+        Clock::time_point now = Clock::now();
+        if (frame >= 0) {
+            frameTimes.add(std::chrono::duration<double, std::milli>(now - frameStart).count());
+        }
+        frameStart = now;
+        frame++;
+
+        collect();
+
+        // Anything still pending in this frame's slot is RING frames old, give up on it so the query can be reused
+        for (auto& t : timers) {
+            if (t.pending[slot()]) {
+                t.pending[slot()] = false;
+                dropped++;
+            }
+        }
+    }
+
+    // Start timing section name, returns its timer for end(). Prefer Scope
+    int begin(const char* name) {
+        int i = 0;
+        while (i < timers.size() && timers[i].name != name) {
+            i++;
+        }
+        if (i == timers.size()) {
+            timers.emplace_back();
+            timers[i].name = name;
+            glGenQueries(RING, timers[i].queries);
+        }
+
+        Timer& t = timers[i];
+        t.queried = !queryActive;
+        if (t.queried) {
+            glBeginQuery(GL_TIME_ELAPSED, t.queries[slot()]);
+            queryActive = true;
+        }
+        t.start = Clock::now();
+        return i;
+    }
+
+    // Stop timing the section begin() returned timer for
+    void end(int timer) {
+        Timer& t = timers[timer];
+        Clock::time_point now = Clock::now();
+        double startUs = sinceEpochUs(t.start);
+        double durationUs = std::chrono::duration<double, std::micro>(now - t.start).count();
+
+        t.cpu.add(durationUs / 1.0e3);
+        record(timer, false, startUs, durationUs);
+
+        if (t.queried) {
+            glEndQuery(GL_TIME_ELAPSED);
+            queryActive = false;
+
+            // llvmpipe gives a nonsense result for the first query, skip the first frame's
+            t.pending[slot()] = frame > 0;
+            t.startUs[slot()] = startUs;
+        }
+    }
+
+    // Rolling averages of every section
+    Stats getStats() const {
+        Stats s;
+        s.frames = frameTimes.samples.size();
+        s.frameMs = frameTimes.mean();
+        s.dropped = dropped;
+        for (auto& t : timers) {
+            s.sections.push_back(SectionStats{ t.name, t.cpu.mean(), t.cpu.max(), t.gpu.mean(), t.gpu.max() });
+        }
+        return s;
+    }
+
+    // Write every recorded section as Chrome trace JSON (chrome://tracing or ui.perfetto.dev).
+    // CPU sections are on one track and GPU sections on another. GL_TIME_ELAPSED only gives
+    // a duration, so GPU sections are placed at the CPU start of the same section
+    bool writeTrace(const std::string& path) const {
+        std::ofstream out(path, std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+            << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n"
+            << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+        for (auto& e : trace) {
+            out << ",\n{\"name\":\"" << timers[e.timer].name << "\",\"cat\":\"" << (e.gpu ? "gpu" : "cpu")
+                << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << (e.gpu ? 2 : 1)
+                << ",\"ts\":" << e.startUs << ",\"dur\":" << e.durationUs << "}";
+        }
+        out << "\n]}\n";
+        return (bool)out;
+    }
+};
+
+// toString for Profiler::Stats
+std::ostream& operator<<(std::ostream& os, const Profiler::Stats& s) {
+    os << "Frame: " << s.frameMs << " ms (average of " << s.frames << " frames), GPU results dropped: " << s.dropped;
+    for (auto& sec : s.sections) {
+        os << "\n  " << sec.name << ": CPU " << sec.cpuMs << " ms (max " << sec.cpuMaxMs << "), GPU "
+           << sec.gpuMs << " ms (max " << sec.gpuMaxMs << ")";
+    }
+    return os;
+}
+
+
+#endif
@@ -0,0 +1,258 @@
+#ifndef RENDERQUEUE_
+#define RENDERQUEUE_
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "GLState.h"
+#include "Geometry.h"
+#include "JobSystem.h"
+#include "Shader.h"
+
+
+// Everything needed to issue one draw call
+struct DrawPacket {
+
+    // Sort key, see RenderQueue::makeKey()
+    uint64_t key;
+
+    // State the draw needs bound, texture is a texture array (see TextureArrays)
+    Shader* shader;
+    unsigned int texture;
+    unsigned int vao;
+
+    // What to draw, instances > 0 draws from the instance buffer in vao.
+    // range picks the submeshes, every submesh if it's null
+    Geometry* geometry;
+    const DrawRange* range;
+    int instances;
+
+    // Level of detail range is from, only used for stats
+    int lod;
+
+    // Model and normal matrix and texture layer for non-instanced draws
+    glm::mat4 model;
+    glm::mat3 normMat;
+    glm::vec3 texLayer;
+
+    // Optional per-draw color (lightColor in the light shader)
+    Uniform<glm::vec4> uColor;
+    glm::vec4 color;
+};
+
+
+// Collects the draws for a frame, sorts them so draws sharing a program,
+// texture array, and vao end up next to each other (or nearest first, see
+// setFrontToBack()), then submits them through GLState so any bind that's
+// already in place is skipped. submitDepth() can lay depth down first so
+// each pixel is only shaded once.
+// Draws can be pushed from JobSystem jobs, each thread gets its own list and
+// they're merged on the GL thread when submitting
+class RenderQueue {
+
+public:
+
+    // Counts from every submit() since the last beginFrame()
+    struct Stats {
+        int draws = 0;
+        long long triangles = 0;
+        int prepassDraws = 0;       // depth only draws, not counted in draws or triangles
+
+        // Draws and triangles at each level of detail
+        int lodDraws[LOD_LEVELS]{};
+        long long lodTriangles[LOD_LEVELS]{};
+    };
+
+private:
+
+    // Shader drawn with in place of another, see setOverride()
+    struct Override {
+        Shader* from;
+        Shader* to;
+        Uniform<glm::vec4> uColor;
+    };
+
+    // One list per JobSystem thread, see setThreads(), merged into packets when submitting
+    std::vector<std::vector<DrawPacket>> lists = std::vector<std::vector<DrawPacket>>(1);
+    std::vector<DrawPacket> packets;
+    std::vector<Override> overrides;
+    bool frontToBack = false;
+    bool prepassed = false;
+    Stats stats;
+
+    // View depth, the low 32 bits of the key
+    static uint32_t keyDepth(const DrawPacket& p) {
+        return (uint32_t)p.key;
+    }
+
+    // Move every thread's list into packets, in thread order
+    void merge() {
+        for (auto& list : lists) {
+            packets.insert(packets.end(), list.begin(), list.end());
+            list.clear();
+        }
+    }
+
+    void sort(bool byDepth) {
+        if (byDepth) {
+            std::sort(packets.begin(), packets.end(), [](const DrawPacket& a, const DrawPacket& b) {
+                return keyDepth(a) != keyDepth(b) ? keyDepth(a) < keyDepth(b) : a.key < b.key;
+            });
+        }
+        else {
+            std::sort(packets.begin(), packets.end(), [](const DrawPacket& a, const DrawPacket& b) { return a.key < b.key; });
+        }
+    }
+
+    // Issue p's draw call with whatever program is in use
+    void draw(const DrawPacket& p) {
+        GLState::get().bindVertexArray(p.vao);
+        const DrawRange& range = p.range ? *p.range : p.geometry->all;
+        if (p.instances > 0) {
+            p.geometry->drawInstanced(range, p.instances);
+        }
+        else {
+            setInstanceAttribs(p.model, p.normMat, p.texLayer);
+            p.geometry->draw(range);
+        }
+    }
+
+public:
+
+    // Pack program, texture, vao, and view depth into a sort key, most significant first.
+    // Ids are truncated to fit, which can only cost a missed grouping, never a wrong draw
+    static uint64_t makeKey(unsigned int program, unsigned int texture, unsigned int vao, float depth) {
+
+        // Positive floats keep their order when compared as integers, closer draws sort first
+        uint32_t depthBits;
+        depth = std::max(depth, 0.0f);
+        std::memcpy(&depthBits, &depth, sizeof(depthBits));
+
+        return ((uint64_t)(program & 0xFF) << 56)
+            | ((uint64_t)(texture & 0xFFF) << 44)
+            | ((uint64_t)(vao & 0xFFF) << 32)
+            | (uint64_t)depthBits;
+    }
+
+    // Add a draw for this frame to the calling thread's list
+    void push(const DrawPacket& p) {
+        lists[JobSystem::threadIndex()].push_back(p);
+    }
+
+    // Make a list for each of jobs' threads so their jobs can push, call before any are pushing
+    void setThreads(const JobSystem& jobs) {
+        lists.resize(jobs.size());
+    }
+
+    // Draw everything queued with from using to instead, until clearOverrides().
+    // Used to draw the same meshes into the deferred G-buffer, to must take the same
+    // vertex inputs as from and the per-draw color is looked up again in to
+    void setOverride(Shader& from, Shader& to) {
+        overrides.push_back(Override{ &from, &to, to.getUniform<glm::vec4>("lightColor") });
+    }
+
+    void clearOverrides() {
+        overrides.clear();
+    }
+
+    // Sort nearest first instead of by state, so depth testing throws away hidden
+    // fragments before they're shaded. Worth more binds when there's no prepass
+    void setFrontToBack(bool enabled) {
+        frontToBack = enabled;
+    }
+
+    // Reset the stats, call once per frame before the first submit
+    void beginFrame() {
+        stats = Stats{};
+    }
+
+    // Sort and draw everything pushed since the last submit, then clear the queue.
+    // Can be called more than once a frame (once per pass), stats add up until beginFrame().
+    // After submitDepth() only fragments at the depth already laid down are drawn
+    void submit() {
+
+        // Depth is already final after a prepass, so there's nothing to gain sorting by it again
+        merge();
+        sort(frontToBack && !prepassed);
+        if (prepassed) {
+            glDepthFunc(GL_EQUAL);
+            glDepthMask(GL_FALSE);
+        }
+
+        GLState& state = GLState::get();
+
+        for (auto& p : packets) {
+
+            Shader* shader = p.shader;
+            Uniform<glm::vec4> uColor = p.uColor;
+            for (auto& o : overrides) {
+                if (o.from == shader) {
+                    shader = o.to;
+                    uColor = p.uColor.valid() ? o.uColor : Uniform<glm::vec4>{};
+                    break;
+                }
+            }
+
+            // Sorted, so most of these are already bound and get skipped
+            shader->use();
+            state.bindTexture(0, GL_TEXTURE_2D_ARRAY, p.texture);
+
+            uColor.set(p.color);
+
+            const DrawRange& range = p.range ? *p.range : p.geometry->all;
+            long long triangles = 0;
+            for (GLsizei count : range.counts) {
+                triangles += (long long)(count / 3) * std::max(p.instances, 1);
+            }
+            stats.triangles += triangles;
+            stats.lodDraws[p.lod]++;
+            stats.lodTriangles[p.lod] += triangles;
+            draw(p);
+            stats.draws++;
+        }
+
+        if (prepassed) {
+            glDepthMask(GL_TRUE);
+            glDepthFunc(GL_LESS);
+            prepassed = false;
+        }
+        packets.clear();
+    }
+
+    // Draw everything queued into the depth buffer only with depthShader, nearest first,
+    // keeping it queued for the next submit() to shade. depthShader must work out gl_Position
+    // the same way as every queued shader, and both must declare it invariant
+    void submitDepth(Shader& depthShader) {
+        merge();
+        sort(true);
+
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        depthShader.use();
+        for (auto& p : packets) {
+            draw(p);
+            stats.prepassDraws++;
+        }
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        prepassed = true;
+    }
+
+    // Get counts from this frame's submits
+    const Stats& getStats() const { return stats; }
+};
+
+// toString for RenderQueue::Stats
+std::ostream& operator<<(std::ostream& os, const RenderQueue::Stats& s) {
+    os << "Draws: " << s.draws << ", Triangles: " << s.triangles << ", Depth prepass draws: " << s.prepassDraws;
+    for (int l = 0; l < LOD_LEVELS; l++) {
+        os << "\n  LOD " << l << ": " << s.lodDraws[l] << " draws, " << s.lodTriangles[l] << " triangles";
+    }
+    return os;
+}
+
+
+#endif
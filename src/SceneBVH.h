@@ -0,0 +1,219 @@
+#ifndef SCENEBVH_
+#define SCENEBVH_
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include "Frustum.h"
+#include "JobSystem.h"
+#include "Mesh.h"
+
+
+// Bounding volume hierarchy over every Mesh in the scene, used to frustum cull.
+// Built once, then refit each frame since meshes move (clock hands)
+// but the scene's layout doesn't change enough to need a rebuild.
+// Culling splits the tree into subtrees that are culled as JobSystem jobs
+class SceneBVH {
+
+public:
+
+    // Counts from the last cull()
+    struct Stats {
+        int visible = 0;
+        int culled = 0;
+        int nodesTested = 0;
+    };
+
+private:
+
+    // Leaves hold items [first, first + count) of order, inner nodes have count 0
+    struct Node {
+        AABB bounds;
+        int left = -1, right = -1;
+        int first = 0, count = 0;
+    };
+
+    // Most items in a leaf
+    static constexpr int LEAF_SIZE = 2;
+
+    // Depth subtrees are handed to jobs at, up to 2^SPLIT_DEPTH of them
+    static constexpr int SPLIT_DEPTH = 4;
+
+    std::vector<Mesh*> items;
+    std::vector<AABB> itemBounds;
+    std::vector<int> order;
+    std::vector<Node> nodes;
+    Stats stats;
+
+    // Subtrees to cull as jobs this cull(), and their counts
+    std::vector<int> subtrees;
+    std::vector<Stats> subtreeStats;
+
+    // World bounds of every item from its current model
+    void updateItemBounds() {
+        for (int i = 0; i < items.size(); i++) {
+            Geometry& g = items[i]->getGeometry();
+            itemBounds[i] = transformAABB(g.boundsMin, g.boundsMax, items[i]->getMesh());
+        }
+    }
+
+    // Split order[first, first + count) at the median along the longest axis of the centers
+    int buildNode(int first, int count) {
+        int index = nodes.size();
+        nodes.emplace_back();
+
+        AABB centers;
+        for (int i = first; i < first + count; i++) {
+            glm::vec3 c = itemBounds[order[i]].center();
+            centers.merge(AABB{ c, c });
+        }
+
+        if (count <= LEAF_SIZE) {
+            nodes[index].first = first;
+            nodes[index].count = count;
+            return index;
+        }
+
+        glm::vec3 size = centers.max - centers.min;
+        int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+
+        int mid = first + count / 2;
+        std::nth_element(order.begin() + first, order.begin() + mid, order.begin() + first + count, [this, axis](int a, int b) {
+            return itemBounds[a].center()[axis] < itemBounds[b].center()[axis];
+        });
+
+        // Children are always after their parent, refit() relies on this
+        int left = buildNode(first, mid - first);
+        int right = buildNode(mid, first + count - mid);
+        nodes[index].left = left;
+        nodes[index].right = right;
+        return index;
+    }
+
+    // Mark every item under node visible without testing
+    void acceptNode(const Node& n, Stats& s) {
+        if (n.count > 0) {
+            for (int i = n.first; i < n.first + n.count; i++) {
+                items[order[i]]->setVisible(true);
+                s.visible++;
+            }
+            return;
+        }
+        acceptNode(nodes[n.left], s);
+        acceptNode(nodes[n.right], s);
+    }
+
+    // Cull n and everything under it. Below depth SPLIT_DEPTH, or for every depth when
+    // split is false, it carries on down, at SPLIT_DEPTH the subtree is saved to subtrees instead
+    void cullNode(int index, const Frustum& frustum, Stats& s, int depth, bool split) {
+        if (split && depth == SPLIT_DEPTH) {
+            subtrees.push_back(index);
+            return;
+        }
+
+        const Node& n = nodes[index];
+        s.nodesTested++;
+        Cull result = frustum.test(n.bounds);
+
+        if (result == Cull::Outside) {
+            return;
+        }
+        if (result == Cull::Inside) {
+            acceptNode(n, s);
+            return;
+        }
+
+        // Crossing, test the children, or each item if this is a leaf
+        if (n.count > 0) {
+            for (int i = n.first; i < n.first + n.count; i++) {
+                bool visible = n.count == 1 || frustum.test(itemBounds[order[i]]) != Cull::Outside;
+                items[order[i]]->setVisible(visible);
+                s.visible += visible;
+            }
+            return;
+        }
+        cullNode(n.left, frustum, s, depth + 1, split);
+        cullNode(n.right, frustum, s, depth + 1, split);
+    }
+
+public:
+
+    // Build the tree over meshes with their current transforms
+    void build(const std::vector<Mesh*>& meshes) {
+        items = meshes;
+        itemBounds.resize(items.size());
+        order.resize(items.size());
+        for (int i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+
+        nodes.clear();
+        updateItemBounds();
+        if (!items.empty()) {
+            buildNode(0, items.size());
+        }
+        refit();
+    }
+
+    // Update every item's and node's bounds from the meshes' current models
+    void refit() {
+        updateItemBounds();
+
+        // Children come after parents, so walking back fills children first
+        for (int i = nodes.size() - 1; i >= 0; i--) {
+            Node& n = nodes[i];
+            n.bounds = AABB{};
+            if (n.count > 0) {
+                for (int j = n.first; j < n.first + n.count; j++) {
+                    n.bounds.merge(itemBounds[order[j]]);
+                }
+            }
+            else {
+                n.bounds.merge(nodes[n.left].bounds);
+                n.bounds.merge(nodes[n.right].bounds);
+            }
+        }
+    }
+
+    // Set every mesh's visible flag from frustum. The top of the tree is culled here and
+    // each subtree still crossing the frustum at SPLIT_DEPTH is culled as a job on jobs
+    void cull(const Frustum& frustum, JobSystem& jobs) {
+        stats = Stats{};
+        for (auto m : items) {
+            m->setVisible(false);
+        }
+        if (nodes.empty()) {
+            return;
+        }
+
+        subtrees.clear();
+        cullNode(0, frustum, stats, 0, true);
+
+        // Subtrees never share an item, so each job only sets its own items' flags
+        subtreeStats.assign(subtrees.size(), Stats{});
+        jobs.dispatch(subtrees.size(), 1, [this, &frustum](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                cullNode(subtrees[i], frustum, subtreeStats[i], SPLIT_DEPTH, false);
+            }
+        });
+        jobs.wait();
+
+        for (auto& s : subtreeStats) {
+            stats.visible += s.visible;
+            stats.nodesTested += s.nodesTested;
+        }
+        stats.culled = items.size() - stats.visible;
+    }
+
+    // Get counts from the last cull()
+    const Stats& getStats() const { return stats; }
+};
+
+// toString for SceneBVH::Stats
+std::ostream& operator<<(std::ostream& os, const SceneBVH::Stats& s) {
+    os << "Visible: " << s.visible << ", Culled: " << s.culled << ", BVH nodes tested: " << s.nodesTested;
+    return os;
+}
+
+
+#endif
@@ -5,8 +5,61 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <string>
+#include <unordered_map>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include "GLState.h"
+
+// GL type enum matching each C++ type a Uniform handle can hold,
+// used to catch handles that don't match the type declared in GLSL
+template <typename T> constexpr GLenum uniformType();
+template <> constexpr GLenum uniformType<glm::mat4>() { return GL_FLOAT_MAT4; }
+template <> constexpr GLenum uniformType<glm::mat3>() { return GL_FLOAT_MAT3; }
+template <> constexpr GLenum uniformType<glm::vec4>() { return GL_FLOAT_VEC4; }
+template <> constexpr GLenum uniformType<glm::vec3>() { return GL_FLOAT_VEC3; }
+template <> constexpr GLenum uniformType<glm::vec2>() { return GL_FLOAT_VEC2; }
+template <> constexpr GLenum uniformType<float>() { return GL_FLOAT; }
+template <> constexpr GLenum uniformType<int>() { return GL_INT; }
+
+// Check a uniform declared as type can be set through a Uniform<T>.
+// Samplers are set with glUniform1i, so int handles also match them
+template <typename T> inline bool uniformTypeMatches(GLenum type) { return type == uniformType<T>(); }
+template <> inline bool uniformTypeMatches<int>(GLenum type) {
+    switch (type) {
+    case GL_INT:
+    case GL_SAMPLER_2D:
+    case GL_SAMPLER_2D_ARRAY:
+    case GL_SAMPLER_2D_SHADOW:
+    case GL_SAMPLER_CUBE:
+    case GL_SAMPLER_CUBE_SHADOW:
+    case GL_SAMPLER_BUFFER:
+    case GL_INT_SAMPLER_BUFFER:
+    case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Typed handle to a uniform location that was resolved when the program was linked.
+// Setting a handle to a uniform that isn't active in the program does nothing,
+// same as the old setUniform* functions when glGetUniformLocation returned -1
+template <typename T>
+struct Uniform {
+    GLint loc = -1;
+
+    bool valid() const { return loc != -1; }
+    void set(const T& v) const;
+};
+
+template <> inline void Uniform<glm::mat4>::set(const glm::mat4& v) const { if (loc != -1) glUniformMatrix4fv(loc, 1, GL_FALSE, glm::value_ptr(v)); }
+template <> inline void Uniform<glm::mat3>::set(const glm::mat3& v) const { if (loc != -1) glUniformMatrix3fv(loc, 1, GL_FALSE, glm::value_ptr(v)); }
+template <> inline void Uniform<glm::vec4>::set(const glm::vec4& v) const { if (loc != -1) glUniform4fv(loc, 1, glm::value_ptr(v)); }
+template <> inline void Uniform<glm::vec3>::set(const glm::vec3& v) const { if (loc != -1) glUniform3fv(loc, 1, glm::value_ptr(v)); }
+template <> inline void Uniform<glm::vec2>::set(const glm::vec2& v) const { if (loc != -1) glUniform2fv(loc, 1, glm::value_ptr(v)); }
+template <> inline void Uniform<float>::set(const float& v) const { if (loc != -1) glUniform1f(loc, v); }
+template <> inline void Uniform<int>::set(const int& v) const { if (loc != -1) glUniform1i(loc, v); }
 
 // Class for shader stuff
 class Shader {
@@ -70,64 +123,122 @@ public:
         // Delete the shaders since they're now linked to our program
         glDeleteShader(vert);
         glDeleteShader(frag);
+
+        // Look up every active uniform once so nothing has to query by name while rendering
+        reflectUniforms();
     }
 
-    // Function to call glUseProgram()
+    // Function to call glUseProgram(), skipped if the program is already in use
     void use() {
-        glUseProgram(id);
+        GLState::get().useProgram(id);
+    }
+
+    // Check if the program has an active uniform called name
+    bool hasUniform(const std::string& name) const {
+        return uniforms.find(name) != uniforms.end();
+    }
+
+    // Get a typed handle to a uniform, invalid handle if it isn't active in the program
+    template <typename T>
+    Uniform<T> getUniform(const std::string& name) const {
+        Uniform<T> u;
+        auto it = uniforms.find(name);
+        if (it == uniforms.end()) {
+            return u;
+        }
+        if (!uniformTypeMatches<T>(it->second.type)) {
+            std::cout << "Uniform type mismatch for \"" << name << "\" in " << vShaderPath << " / " << fShaderPath << std::endl;
+            return u;
+        }
+        u.loc = it->second.loc;
+        return u;
+    }
+
+    // Attach the uniform block called name to binding point, does nothing if
+    // the program doesn't use that block
+    bool bindUniformBlock(const std::string& name, GLuint binding) {
+        GLuint index = glGetUniformBlockIndex(id, name.c_str());
+        if (index == GL_INVALID_INDEX) {
+            return false;
+        }
+        glUniformBlockBinding(id, index, binding);
+        return true;
     }
 
     // Sets uniform mat3 in shader
     bool setUniformMat3(const std::string name, const glm::mat3& mat) {
-        unsigned int loc = glGetUniformLocation(id, name.c_str());
-        if (loc != -1) {
-            glUniformMatrix3fv(loc, 1, GL_FALSE, glm::value_ptr(mat));
-            return true;
-        }
-        return false;
+        Uniform<glm::mat3> u = getUniform<glm::mat3>(name);
+        u.set(mat);
+        return u.valid();
     }
 
     // Sets uniform mat4 in shader
     bool setUniformMat4(const std::string name, const glm::mat4& mat) {
-        unsigned int loc = glGetUniformLocation(id, name.c_str());
-        if (loc != -1) {
-            glUniformMatrix4fv(loc, 1, GL_FALSE, glm::value_ptr(mat));
-            return true;
-        }
-        return false;
+        Uniform<glm::mat4> u = getUniform<glm::mat4>(name);
+        u.set(mat);
+        return u.valid();
     }
 
     // Sets uniform vec3 in shader
     bool setUniformVec3(const std::string name, const glm::vec3& mat) {
-        unsigned int loc = glGetUniformLocation(id, name.c_str());
-        if (loc != -1) {
-            glUniform3fv(loc, 1, glm::value_ptr(mat));
-            return true;
-        }
-        return false;
+        Uniform<glm::vec3> u = getUniform<glm::vec3>(name);
+        u.set(mat);
+        return u.valid();
     }
     // Sets uniform vec4 in shader
     bool setUniformVec4(const std::string name, const glm::vec4& mat) { 
-        unsigned int loc = glGetUniformLocation(id, name.c_str()); 
-        if (loc != -1) {
-            glUniform4fv(loc, 1, glm::value_ptr(mat));
-            return true;
-        }
-        return false;
+        Uniform<glm::vec4> u = getUniform<glm::vec4>(name);
+        u.set(mat);
+        return u.valid();
     }
 
     // Sets uniform float in shader
     bool setUniformFloat(const std::string name, const float f) {
-        unsigned int loc = glGetUniformLocation(id, name.c_str());
-        if (loc != -1) {
-            glUniform1f(loc, f);
-            return true;
-        }
-        return false;
+        Uniform<float> u = getUniform<float>(name);
+        u.set(f);
+        return u.valid();
     }
 
 
 private:
+
+    // Location and GL type of an active uniform
+    struct UniformInfo {
+        GLint loc;
+        GLenum type;
+    };
+
+    // Active uniforms by name, filled once after linking
+    std::unordered_map<std::string, UniformInfo> uniforms;
+
+    // Query every active uniform in the linked program and store its location.
+    // Arrays are reported as "name[0]", so those are also stored under "name"
+    void reflectUniforms() {
+        int count = 0, maxLen = 0;
+        glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLen);
+
+        std::string name(maxLen, '\0');
+        for (int i = 0; i < count; i++) {
+            GLsizei len = 0;
+            GLint arraySize = 0;
+            GLenum type = 0;
+            glGetActiveUniform(id, i, maxLen, &len, &arraySize, &type, &name[0]);
+            std::string uName = name.substr(0, len);
+
+            // Uniforms inside a uniform block have no location
+            GLint loc = glGetUniformLocation(id, uName.c_str());
+            if (loc == -1) {
+                continue;
+            }
+            uniforms[uName] = { loc, type };
+
+            if (uName.size() > 3 && uName.compare(uName.size() - 3, 3, "[0]") == 0) {
+                uniforms[uName.substr(0, uName.size() - 3)] = { loc, type };
+            }
+        }
+    }
+
     // Error checking 
     void checkCompileErrors(unsigned int shader, std::string type) {
         int success;
@@ -0,0 +1,370 @@
+#ifndef SHADOWMAPS_
+#define SHADOWMAPS_
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include "Frustum.h"
+#include "Geometry.h"
+#include "GLState.h"
+#include "Light.h"
+#include "LightMesh.h"
+#include "Mesh.h"
+#include "Shader.h"
+
+
+// Lights that can have a shadow map, must match the shadowMap samplers in the shaders
+constexpr int MAX_SHADOW_LIGHTS = 3;
+
+// Texture unit of the first light's cube map, the rest follow it (after the light buffers, see LightClusters.h)
+constexpr int SHADOW_MAP_UNIT = 7;
+
+
+// Cube shadow maps for point lights, cached between frames.
+// Each light has two cube maps, one with only the static casters and the one
+// that's sampled, which is the static one plus whatever has moved. A caster
+// becomes dynamic the first time it moves and is dropped from the static map.
+// A face is only drawn again when something in it changes: the light moving
+// redraws the static map, a dynamic caster moving inside a face just copies the
+// static face back and draws the dynamic casters over it. At most budget faces
+// are redrawn per frame, the rest wait their turn
+class ShadowMaps {
+
+public:
+
+    // Counts from the last update()
+    struct Stats {
+        int lights = 0;
+        int staticFaces = 0;    // faces whose static casters were drawn again
+        int faces = 0;          // faces redrawn (static copy plus dynamic casters)
+        int draws = 0;
+        long long triangles = 0;
+        int pending = 0;        // faces still out of date, waiting on the budget
+    };
+
+private:
+
+    // Shadow maps don't reach further than this, past it lights aren't shadowed
+    static constexpr float MAX_REACH = 50.0f;
+    static constexpr float NEAR_PLANE = 0.05f;
+
+    // What's stored for each caster to notice when it moves
+    struct Caster {
+        Mesh* mesh;
+        glm::mat4 model;
+        AABB bounds;
+        bool dynamic;
+    };
+
+    struct ShadowLight {
+        LightMesh* mesh;
+        glm::vec3 pos;
+        float farPlane;
+        GLuint staticMap, liveMap;
+        glm::mat4 viewProj[6];
+        std::vector<Frustum> frusta;
+        bool staticDirty[6];
+        bool liveDirty[6];
+    };
+
+    int size;
+    int budget;
+    Shader& shader;
+
+    std::vector<ShadowLight> lights;
+    std::vector<Caster> casters;
+
+    // Framebuffers the faces are attached to when drawing and copying
+    GLuint drawFbo{}, readFbo{};
+
+    // Where update() picks up looking for out of date faces, so every face gets a turn
+    int cursor = 0;
+
+    // Index of each map's light in the list passed to update()
+    glm::ivec4 lightIndices{ -1 };
+
+    Uniform<glm::mat4> uViewProj;
+    Uniform<glm::vec3> uLightPos;
+    Uniform<float> uFar;
+
+    Stats stats;
+
+    // Look direction and up for each face, in GL's cube map face order (+x, -x, +y, -y, +z, -z)
+    static void faceAxes(int face, glm::vec3& dir, glm::vec3& up) {
+        switch (face) {
+        case 0: dir = glm::vec3(1.0f, 0.0f, 0.0f); up = glm::vec3(0.0f, -1.0f, 0.0f); break;
+        case 1: dir = glm::vec3(-1.0f, 0.0f, 0.0f); up = glm::vec3(0.0f, -1.0f, 0.0f); break;
+        case 2: dir = glm::vec3(0.0f, 1.0f, 0.0f); up = glm::vec3(0.0f, 0.0f, 1.0f); break;
+        case 3: dir = glm::vec3(0.0f, -1.0f, 0.0f); up = glm::vec3(0.0f, 0.0f, -1.0f); break;
+        case 4: dir = glm::vec3(0.0f, 0.0f, 1.0f); up = glm::vec3(0.0f, -1.0f, 0.0f); break;
+        default: dir = glm::vec3(0.0f, 0.0f, -1.0f); up = glm::vec3(0.0f, -1.0f, 0.0f); break;
+        }
+    }
+
+    // size x size depth cube map, every face cleared to the far plane so nothing is shadowed until it's drawn
+    GLuint makeCube(bool compare) {
+        GLuint id;
+        glGenTextures(1, &id);
+        GLState::get().bindTexture(SHADOW_MAP_UNIT, GL_TEXTURE_CUBE_MAP, id);
+        for (int f = 0; f < 6; f++) {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + f, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+        }
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, compare ? GL_LINEAR : GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, compare ? GL_LINEAR : GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        if (compare) {
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, drawFbo);
+        for (int f = 0; f < 6; f++) {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + f, id, 0);
+            glClear(GL_DEPTH_BUFFER_BIT);
+        }
+        return id;
+    }
+
+    // Work out the face matrices for the light's current position
+    void placeLight(ShadowLight& sl) {
+        sl.pos = sl.mesh->getLightSource().lightPos;
+        glm::mat4 proj = glm::perspective(glm::radians(90.0f), 1.0f, NEAR_PLANE, sl.farPlane);
+        for (int f = 0; f < 6; f++) {
+            glm::vec3 dir, up;
+            faceAxes(f, dir, up);
+            sl.viewProj[f] = proj * glm::lookAt(sl.pos, sl.pos + dir, up);
+            sl.frusta[f] = Frustum(sl.viewProj[f]);
+            sl.staticDirty[f] = true;
+            sl.liveDirty[f] = true;
+        }
+    }
+
+    // Mark the faces of every light that can see box as needing redrawing, and their static maps too if baked
+    void touch(const AABB& box, Mesh* mesh, bool baked) {
+        for (auto& sl : lights) {
+            if (sl.mesh == mesh) {
+                continue;
+            }
+            for (int f = 0; f < 6; f++) {
+                if (sl.frusta[f].test(box) != Cull::Outside) {
+                    sl.liveDirty[f] = true;
+                    sl.staticDirty[f] = sl.staticDirty[f] || baked;
+                }
+            }
+        }
+    }
+
+    // Draw the casters that are dynamic (or not) and inside face of sl, into the attached face
+    void drawCasters(ShadowLight& sl, int face, bool dynamic) {
+        GLState& state = GLState::get();
+        for (auto& c : casters) {
+            if (c.dynamic != dynamic || c.mesh == sl.mesh || sl.frusta[face].test(c.bounds) == Cull::Outside) {
+                continue;
+            }
+            Geometry& g = c.mesh->getGeometry();
+            state.bindVertexArray(g.vao);
+            setInstanceAttribs(c.model * g.dequant, glm::mat3(1.0f), glm::vec3(0.0f));
+            g.draw();
+            stats.draws++;
+            stats.triangles += g.lodTriangles[0];
+        }
+    }
+
+    void attachFace(GLenum target, GLuint fbo, GLuint cube, int face) {
+        glBindFramebuffer(target, fbo);
+        glFramebufferTexture2D(target, GL_DEPTH_ATTACHMENT, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, cube, 0);
+    }
+
+    // Bring one face of sl up to date
+    void redrawFace(ShadowLight& sl, int face) {
+        shader.use();
+        uViewProj.set(sl.viewProj[face]);
+        uLightPos.set(sl.pos);
+        uFar.set(sl.farPlane);
+
+        if (sl.staticDirty[face]) {
+            attachFace(GL_FRAMEBUFFER, drawFbo, sl.staticMap, face);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            drawCasters(sl, face, false);
+            sl.staticDirty[face] = false;
+            stats.staticFaces++;
+        }
+
+        // Copy the static face over, then add the dynamic casters
+        attachFace(GL_READ_FRAMEBUFFER, readFbo, sl.staticMap, face);
+        attachFace(GL_DRAW_FRAMEBUFFER, drawFbo, sl.liveMap, face);
+        glBlitFramebuffer(0, 0, size, size, 0, 0, size, size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, drawFbo);
+        drawCasters(sl, face, true);
+        sl.liveDirty[face] = false;
+        stats.faces++;
+    }
+
+public:
+
+    // size x size faces, redrawing at most budget faces per frame. shader draws the casters (see main.cpp)
+    ShadowMaps(int size, int budget, Shader& shader) : size(size), budget(budget), shader(shader) {
+        glGenFramebuffers(1, &drawFbo);
+        glGenFramebuffers(1, &readFbo);
+
+        // Depth only, nothing to draw or read colour from
+        glBindFramebuffer(GL_FRAMEBUFFER, drawFbo);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        glBindFramebuffer(GL_FRAMEBUFFER, readFbo);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        uViewProj = shader.getUniform<glm::mat4>("faceViewProj");
+        uLightPos = shader.getUniform<glm::vec3>("lightPos");
+        uFar = shader.getUniform<float>("farPlane");
+    }
+
+    // Give lm's light a shadow map, returns false once MAX_SHADOW_LIGHTS have one.
+    // lm itself never shadows its own light
+    bool addLight(LightMesh& lm) {
+        if (lights.size() >= MAX_SHADOW_LIGHTS) {
+            std::cout << "Only " << MAX_SHADOW_LIGHTS << " lights can have shadow maps" << std::endl;
+            return false;
+        }
+
+        // How far the light could reach at full brightness, so colour changes don't move the far plane
+        Light white = lm.getLightSource();
+        white.lightColor = glm::vec3(1.0f);
+
+        ShadowLight sl{};
+        sl.mesh = &lm;
+        float reach = lightRadius(white);
+        sl.farPlane = reach < MAX_REACH ? reach : MAX_REACH;
+        sl.frusta.assign(6, Frustum(glm::mat4(1.0f)));
+        sl.staticMap = makeCube(false);
+        sl.liveMap = makeCube(true);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        placeLight(sl);
+        lights.push_back(sl);
+        return true;
+    }
+
+    // Meshes that cast shadows, with their transforms already worked out
+    void setCasters(const std::vector<Mesh*>& meshes) {
+        casters.clear();
+        for (auto m : meshes) {
+            Geometry& g = m->getGeometry();
+            casters.push_back(Caster{ m, m->getMesh(), transformAABB(g.boundsMin, g.boundsMax, m->getMesh()), false });
+        }
+        for (auto& sl : lights) {
+            placeLight(sl);
+        }
+    }
+
+    // Point shader's shadow samplers at their units
+    void attach(Shader& s) {
+        s.use();
+        s.getUniform<int>("shadowMap0").set(SHADOW_MAP_UNIT);
+        s.getUniform<int>("shadowMap1").set(SHADOW_MAP_UNIT + 1);
+        s.getUniform<int>("shadowMap2").set(SHADOW_MAP_UNIT + 2);
+    }
+
+    // Find what moved since last frame and redraw up to budget out of date faces into their maps,
+    // then bind every map and go back to drawing into target. all is every light in the order
+    // passed to LightClusters::update(). Call after TransformSystem::update()
+    void update(const std::vector<Light*>& all, GLuint target) {
+        stats = Stats{};
+        stats.lights = lights.size();
+
+        // Where each shadowed light is in all, for the shaders to match them up
+        for (int i = 0; i < lights.size(); i++) {
+            auto it = std::find(all.begin(), all.end(), &lights[i].mesh->getLightSource());
+            lightIndices[i] = it == all.end() ? -1 : (int)(it - all.begin());
+        }
+
+        // Casters that moved make the faces they left and the ones they're in out of date.
+        // The first time one moves it's still in the static maps, so those have to be redrawn without it
+        for (auto& c : casters) {
+            const glm::mat4& model = c.mesh->getMesh();
+            if (std::memcmp(&model, &c.model, sizeof(glm::mat4)) == 0) {
+                continue;
+            }
+            touch(c.bounds, c.mesh, !c.dynamic);
+            c.dynamic = true;
+            Geometry& g = c.mesh->getGeometry();
+            c.model = model;
+            c.bounds = transformAABB(g.boundsMin, g.boundsMax, model);
+            touch(c.bounds, c.mesh, false);
+        }
+
+        // A light that moved needs every face drawn again
+        for (auto& sl : lights) {
+            glm::vec3 d = sl.mesh->getLightSource().lightPos - sl.pos;
+            if (glm::dot(d, d) > 1e-8f) {
+                placeLight(sl);
+            }
+        }
+
+        // Round robin through every face, starting after the last one redrawn
+        int total = lights.size() * 6;
+        int start = cursor;
+        GLint viewport[4];
+        bool drew = false;
+        for (int i = 0; i < total; i++) {
+            int index = (start + i) % total;
+            ShadowLight& sl = lights[index / 6];
+            int face = index % 6;
+            if (!sl.liveDirty[face]) {
+                continue;
+            }
+            if (stats.faces >= budget) {
+                stats.pending++;
+                continue;
+            }
+            if (!drew) {
+                glGetIntegerv(GL_VIEWPORT, viewport);
+                glViewport(0, 0, size, size);
+                drew = true;
+            }
+            redrawFace(sl, face);
+            cursor = (index + 1) % total;
+        }
+
+        if (drew) {
+            glBindFramebuffer(GL_FRAMEBUFFER, target);
+            glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        }
+
+        for (int i = 0; i < lights.size(); i++) {
+            GLState::get().bindTexture(SHADOW_MAP_UNIT + i, GL_TEXTURE_CUBE_MAP, lights[i].liveMap);
+        }
+    }
+
+    // Values for the Frame block, the index of the light each shadow map belongs to (-1 if
+    // unused) as of the last update(), and each map's far plane
+    glm::ivec4 getLightIndices() const { return lightIndices; }
+
+    glm::vec4 getFarPlanes() const {
+        float f[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        for (int i = 0; i < lights.size(); i++) {
+            f[i] = lights[i].farPlane;
+        }
+        return glm::vec4(f[0], f[1], f[2], f[3]);
+    }
+
+    // Get counts from the last update()
+    const Stats& getStats() const { return stats; }
+};
+
+// toString for ShadowMaps::Stats
+std::ostream& operator<<(std::ostream& os, const ShadowMaps::Stats& s) {
+    os << "Shadow lights: " << s.lights << ", Faces redrawn: " << s.faces << " (" << s.staticFaces << " static), Shadow draws: " << s.draws << " (" << s.triangles << " triangles), Faces waiting: " << s.pending;
+    return os;
+}
+
+
+#endif
@@ -0,0 +1,310 @@
+#ifndef SIMPLIFY_
+#define SIMPLIFY_
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+
+// Symmetric 4x4 error quadric (Garland and Heckbert), error() is the
+// weighted sum of squared distances from a point to every plane added
+struct Quadric {
+
+    // xx, xy, xz, xw, yy, yz, yw, zz, zw, ww
+    double q[10]{};
+
+    // Add the plane n.p + d = 0, n must be unit length
+    void addPlane(const glm::vec3& n, float d, float weight) {
+        double a = n.x, b = n.y, c = n.z, w = weight;
+        q[0] += w * a * a; q[1] += w * a * b; q[2] += w * a * c; q[3] += w * a * d;
+        q[4] += w * b * b; q[5] += w * b * c; q[6] += w * b * d;
+        q[7] += w * c * c; q[8] += w * c * d;
+        q[9] += w * d * d;
+    }
+
+    void add(const Quadric& o) {
+        for (int i = 0; i < 10; i++) {
+            q[i] += o.q[i];
+        }
+    }
+
+    double error(const glm::vec3& p) const {
+        double x = p.x, y = p.y, z = p.z;
+        return q[0] * x * x + 2.0 * q[1] * x * y + 2.0 * q[2] * x * z + 2.0 * q[3] * x
+            + q[4] * y * y + 2.0 * q[5] * y * z + 2.0 * q[6] * y
+            + q[7] * z * z + 2.0 * q[8] * z
+            + q[9];
+    }
+};
+
+
+// Reduce elements (triangles indexing verticies, 8 float layout) to about targetCount elements by
+// collapsing edges, cheapest first by quadric error. A collapse only ever moves a vertex onto its
+// neighbour, so the result indexes the same verticies and nothing needs adding to the vbo.
+// Verticies split at uv or normal seams are welded by position while collapsing, and borders
+// and seams get extra planes so they hold their shape
+inline std::vector<GLuint> simplifyElements(const GLfloat* verticies, size_t vertexCount,
+                                            const GLuint* elements, size_t elementCount, size_t targetCount) {
+
+    // How much more a border or seam plane counts than a surface plane
+    const float BORDER_WEIGHT = 10.0f;
+
+    // Weld verticies with the same position, collapses work on these.
+    // wedges holds the verticies at each position, they can differ in uv and normal
+    struct PositionKey {
+        uint32_t x, y, z;
+        bool operator==(const PositionKey& o) const { return x == o.x && y == o.y && z == o.z; }
+    };
+    struct PositionHash {
+        size_t operator()(const PositionKey& k) const { return k.x * 73856093u ^ k.y * 19349663u ^ k.z * 83492791u; }
+    };
+
+    std::vector<uint32_t> weld(vertexCount);
+    std::vector<glm::vec3> pos;
+    std::vector<std::vector<GLuint>> wedges;
+    {
+        std::unordered_map<PositionKey, uint32_t, PositionHash> welded;
+        for (size_t i = 0; i < vertexCount; i++) {
+
+            // + 0.0f so -0 and 0 weld together
+            float p[3] = { verticies[8 * i] + 0.0f, verticies[8 * i + 1] + 0.0f, verticies[8 * i + 2] + 0.0f };
+            PositionKey k;
+            std::memcpy(&k, p, sizeof(k));
+
+            auto it = welded.emplace(k, (uint32_t)pos.size()).first;
+            if (it->second == pos.size()) {
+                pos.push_back(glm::vec3(p[0], p[1], p[2]));
+                wedges.emplace_back();
+            }
+            weld[i] = it->second;
+            wedges[it->second].push_back((GLuint)i);
+        }
+    }
+
+    // Squared uv and normal distance between two verticies
+    auto attribDistance = [&](GLuint a, GLuint b) {
+        float d = 0.0f;
+        for (int k = 3; k < 8; k++) {
+            float x = verticies[8 * a + k] - verticies[8 * b + k];
+            d += x * x;
+        }
+        return d;
+    };
+
+    // Corner verticies and their welded positions, 3 per triangle
+    size_t triCount = elementCount / 3;
+    std::vector<GLuint> corner(elements, elements + triCount * 3);
+    std::vector<uint32_t> tri(triCount * 3);
+    std::vector<bool> dead(triCount);
+    size_t live = 0;
+
+    std::vector<std::vector<uint32_t>> around(pos.size());
+    std::vector<Quadric> quadrics(pos.size());
+
+    auto triNormal = [&](size_t t) {
+        return glm::cross(pos[tri[3 * t + 1]] - pos[tri[3 * t]], pos[tri[3 * t + 2]] - pos[tri[3 * t]]);
+    };
+
+    // Every triangle adds its plane to its corners, weighted by area
+    for (size_t t = 0; t < triCount; t++) {
+        for (int k = 0; k < 3; k++) {
+            tri[3 * t + k] = weld[corner[3 * t + k]];
+        }
+        uint32_t a = tri[3 * t], b = tri[3 * t + 1], c = tri[3 * t + 2];
+        if (a == b || b == c || a == c) {
+            dead[t] = true;
+            continue;
+        }
+        live++;
+
+        glm::vec3 n = triNormal(t);
+        float area = glm::length(n);
+        if (area > 0.0f) {
+            n /= area;
+            for (int k = 0; k < 3; k++) {
+                quadrics[tri[3 * t + k]].addPlane(n, -glm::dot(n, pos[a]), area * 0.5f);
+            }
+        }
+        for (int k = 0; k < 3; k++) {
+            around[tri[3 * t + k]].push_back((uint32_t)t);
+        }
+    }
+
+    // Find edges used by only one triangle (borders) or whose two sides use different uvs or normals (seams)
+    struct EdgeUse {
+        int uses;
+        GLuint v0, v1;      // Corner verticies of the first triangle seen, at the lower and higher position
+        bool seam;
+    };
+    auto edgeKey = [](uint32_t a, uint32_t b) {
+        return a < b ? (uint64_t)a << 32 | b : (uint64_t)b << 32 | a;
+    };
+    std::unordered_map<uint64_t, EdgeUse> edges;
+    for (size_t t = 0; t < triCount; t++) {
+        if (dead[t]) {
+            continue;
+        }
+        for (int k = 0; k < 3; k++) {
+            int k1 = (k + 1) % 3;
+            uint32_t a = tri[3 * t + k], b = tri[3 * t + k1];
+            GLuint va = corner[3 * t + k], vb = corner[3 * t + k1];
+            if (a > b) {
+                std::swap(va, vb);
+            }
+
+            auto it = edges.find(edgeKey(a, b));
+            if (it == edges.end()) {
+                edges.emplace(edgeKey(a, b), EdgeUse{ 1, va, vb, false });
+                continue;
+            }
+            EdgeUse& e = it->second;
+            e.uses++;
+            e.seam = e.seam || attribDistance(e.v0, va) > 1e-6f || attribDistance(e.v1, vb) > 1e-6f;
+        }
+    }
+
+    // Add a plane through each border or seam edge at right angles to its triangle
+    for (size_t t = 0; t < triCount; t++) {
+        if (dead[t]) {
+            continue;
+        }
+        glm::vec3 n = triNormal(t);
+        for (int k = 0; k < 3; k++) {
+            uint32_t a = tri[3 * t + k], b = tri[3 * t + (k + 1) % 3];
+            const EdgeUse& e = edges[edgeKey(a, b)];
+            if (e.uses != 1 && !e.seam) {
+                continue;
+            }
+            glm::vec3 edge = pos[b] - pos[a];
+            glm::vec3 side = glm::cross(edge, n);
+            float len = glm::length(side);
+            if (len > 0.0f) {
+                side /= len;
+                float weight = glm::dot(edge, edge) * BORDER_WEIGHT;
+                quadrics[a].addPlane(side, -glm::dot(side, pos[a]), weight);
+                quadrics[b].addPlane(side, -glm::dot(side, pos[a]), weight);
+            }
+        }
+    }
+
+    // Candidate collapses, cheapest first. A position's version goes up every time its
+    // quadric changes, so candidates queued before that are skipped when they come up
+    struct Collapse {
+        double cost;
+        uint32_t from, to;
+        uint32_t fromVersion, toVersion;
+        bool operator<(const Collapse& o) const { return cost > o.cost; }
+    };
+    std::priority_queue<Collapse> heap;
+    std::vector<uint32_t> version(pos.size());
+    std::vector<bool> removed(pos.size());
+
+    // Queue moving a onto b and b onto a
+    auto push = [&](uint32_t a, uint32_t b) {
+        Quadric q = quadrics[a];
+        q.add(quadrics[b]);
+        heap.push(Collapse{ q.error(pos[b]), a, b, version[a], version[b] });
+        heap.push(Collapse{ q.error(pos[a]), b, a, version[b], version[a] });
+    };
+    for (auto& e : edges) {
+        push((uint32_t)(e.first >> 32), (uint32_t)e.first);
+    }
+
+    // Check if moving from onto to turns any triangle that's kept over
+    auto flips = [&](uint32_t from, uint32_t to) {
+        for (uint32_t t : around[from]) {
+            const uint32_t* v = &tri[3 * t];
+            if (dead[t] || v[0] == to || v[1] == to || v[2] == to) {
+                continue;
+            }
+            glm::vec3 p[3];
+            for (int k = 0; k < 3; k++) {
+                p[k] = v[k] == from ? pos[to] : pos[v[k]];
+            }
+            if (glm::dot(triNormal(t), glm::cross(p[1] - p[0], p[2] - p[0])) <= 0.0f) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    std::vector<uint32_t> neighbours;
+    while (live * 3 > targetCount && !heap.empty()) {
+        Collapse c = heap.top();
+        heap.pop();
+        if (removed[c.from] || removed[c.to] || version[c.from] != c.fromVersion || version[c.to] != c.toVersion) {
+            continue;
+        }
+        if (flips(c.from, c.to)) {
+            continue;
+        }
+
+        // Triangles on the edge go away, the rest move their corner over to the wedge at to
+        // with the closest uv and normal
+        for (uint32_t t : around[c.from]) {
+            uint32_t* v = &tri[3 * t];
+            if (dead[t]) {
+                continue;
+            }
+            if (v[0] == c.to || v[1] == c.to || v[2] == c.to) {
+                dead[t] = true;
+                live--;
+                continue;
+            }
+            for (int k = 0; k < 3; k++) {
+                if (v[k] != c.from) {
+                    continue;
+                }
+                v[k] = c.to;
+                GLuint best = wedges[c.to][0];
+                for (GLuint w : wedges[c.to]) {
+                    if (attribDistance(w, corner[3 * t + k]) < attribDistance(best, corner[3 * t + k])) {
+                        best = w;
+                    }
+                }
+                corner[3 * t + k] = best;
+            }
+            around[c.to].push_back(t);
+        }
+        std::vector<uint32_t>().swap(around[c.from]);
+
+        quadrics[c.to].add(quadrics[c.from]);
+        removed[c.from] = true;
+        version[c.to]++;
+
+        // Drop dead triangles from to's list and queue its edges again with the merged quadric
+        std::vector<uint32_t>& list = around[c.to];
+        list.erase(std::remove_if(list.begin(), list.end(), [&](uint32_t t) { return dead[t]; }), list.end());
+        neighbours.clear();
+        for (uint32_t t : list) {
+            for (int k = 0; k < 3; k++) {
+                if (tri[3 * t + k] != c.to) {
+                    neighbours.push_back(tri[3 * t + k]);
+                }
+            }
+        }
+        std::sort(neighbours.begin(), neighbours.end());
+        neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+        for (uint32_t n : neighbours) {
+            push(c.to, n);
+        }
+    }
+
+    std::vector<GLuint> result;
+    result.reserve(live * 3);
+    for (size_t t = 0; t < triCount; t++) {
+        if (!dead[t]) {
+            result.insert(result.end(), &corner[3 * t], &corner[3 * t] + 3);
+        }
+    }
+    return result;
+}
+
+
+#endif
@@ -4,57 +4,138 @@
 #include <string>
 #include <GL/glew.h>
 #include <iostream>
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+#include "AssetLoader.h"
+#include "MappedFile.h"
+#include "MipChain.h"
+#include "TextureCache.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
 
-// Class for Texture
+// How a Texture is stored on the GPU
+//   RGBA8:      uncompressed, 4 bytes per pixel
+//   Compressed: BC1 (opaque) or BC3 (with alpha), 4:1 or 8:1 smaller but lossy
+enum class TextureFormat {
+    RGBA8,
+    Compressed
+};
+
+
+// Class for Texture. The full mip chain is cached next to the image
+// (see TextureCache.h) so it's only decoded and mipmapped when the image changes.
+// Textures don't get their own GL texture, TextureArrays packs them into
+// layers of a GL_TEXTURE_2D_ARRAY once they're loaded
 class Texture {
 public:
-    unsigned int id{};          // Holds texture ID
+    unsigned int id{};          // Texture array holding this texture, 0 until it's packed
+    int layer{};                // Layer in the array
+
+    // Part of the layer the image covers, images that aren't a power of two are padded out
+    glm::vec2 uvScale{ 1.0f, 1.0f };
 
-    Texture(std::string texPath) {
+    std::string path;
+    TextureFormat format;
 
-        // Generate texture
-        glGenTextures(1, &id);
-        glBindTexture(GL_TEXTURE_2D, id);
+    // Queue the texture on loader, it's decoded during loader.loadAll() and uploaded by TextureArrays::pack()
+    Texture(AssetLoader& loader, std::string texPath, TextureFormat f = TextureFormat::RGBA8) : path(texPath), format(f) {
 
-        // Setting texture attribs
+        // Needs the GL context, so check here rather than on the loader thread
+        if (format == TextureFormat::Compressed && !GLEW_EXT_texture_compression_s3tc) {
+            std::cout << "S3TC not supported, loading " << path << " uncompressed" << std::endl;
+            format = TextureFormat::RGBA8;
+        }
+
+        loader.add(path, [this] { decode(); }, [this] { upload(); });
+    }
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT); 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT); 
+    // uvScale and layer packed the way the shaders' texLayer attribute wants them
+    glm::vec3 layerAttrib() const { return glm::vec3(uvScale, (float)layer); }
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+private:
+
+    friend class TextureArrays;
+
+    // Mip chain, only held until it's packed.
+    // Either the mapped cache or one built from the image
+    std::unique_ptr<TextureCache> cache;
+    MipChain chain;
+
+    // Where the levels are, set in upload() from cache or chain
+    MipFormat mipFormat = MipFormat::RGBA8;
+    const MipLevel* levels = nullptr;
+    size_t levelCount = 0;
+    const unsigned char* levelData = nullptr;
+
+    // Map the cached mip chain, or decode the image and build one. Runs on a loader thread so no GL calls here
+    void decode() {
+        bool compressed = format == TextureFormat::Compressed;
+
+        uint64_t sourceHash = hashFile(path);
+        cache = std::make_unique<TextureCache>(path, compressed, sourceHash);
+        if (sourceHash != 0 && cache->valid()) {
+            return;
+        }
+        cache.reset();
 
-        // Image information
         int width, height, bytesperpixel;
-        unsigned char* data = stbi_load(texPath.c_str(), &width, &height, &bytesperpixel, 0);
-
-        // Check format of image and set the value accordingly
-        GLenum format{};
-        if (bytesperpixel == 1)
-            format = GL_RED;
-        else if (bytesperpixel == 3)
-            format = GL_RGB;
-        else if (bytesperpixel == 4)
-            format = GL_RGBA;
-
-        // Create texutre if data is not null
-        if (data) {
-            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data); 
-            glGenerateMipmap(GL_TEXTURE_2D);
+        unsigned char* data = stbi_load(path.c_str(), &width, &height, &bytesperpixel, 0);
+        if (!data) {
+            return;
+        }
+
+        // Pad to a power of two so it shares an array with other textures of the same size
+        uint32_t paddedWidth, paddedHeight;
+        std::vector<unsigned char> rgba = padToPowerOfTwo(toRGBA(data, width, height, bytesperpixel), width, height, paddedWidth, paddedHeight);
+        stbi_image_free(data);
+
+        chain = buildMipChain(std::move(rgba), paddedWidth, paddedHeight, compressed);
+        chain.uvScale[0] = (float)width / paddedWidth;
+        chain.uvScale[1] = (float)height / paddedHeight;
+
+        if (!TextureCache::write(path, sourceHash, chain)) {
+            std::cout << "Couldn't write texture cache " << TextureCache::cachePath(path, compressed) << std::endl;
+        }
+    }
+
+    // Point levels at the cache or chain, runs on the GL thread but there's nothing
+    // to upload yet since the array sizes aren't known until every texture is loaded
+    void upload() {
+        if (cache) {
+            mipFormat = cache->getHeader().format;
+            levels = cache->levels();
+            levelCount = cache->getHeader().levelCount;
+            levelData = cache->data();
+            uvScale = glm::vec2(cache->getHeader().uvScale[0], cache->getHeader().uvScale[1]);
         }
         else {
-            std::cout << "Failed to load texture" << std::endl;
+            mipFormat = chain.format;
+            levels = chain.levels.data();
+            levelCount = chain.levels.size();
+            levelData = chain.data.data();
+            uvScale = glm::vec2(chain.uvScale[0], chain.uvScale[1]);
         }
 
-        // free data and unbind texture
-        stbi_image_free(data);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        if (levelCount == 0) {
+            std::cout << "Failed to load texture " << path << std::endl;
+        }
+    }
+
+    // Check if there's a mip chain waiting to be packed
+    bool loaded() const { return levelCount > 0; }
+
+    // Drop the mip chain once it's in a texture array
+    void release() {
+        cache.reset();
+        chain = MipChain{};
+        levels = nullptr;
+        levelCount = 0;
+        levelData = nullptr;
     }
 };
 
 
-#endif 
+#endif
@@ -0,0 +1,116 @@
+#ifndef TEXTUREARRAYS_
+#define TEXTUREARRAYS_
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <set>
+#include <tuple>
+#include <vector>
+#include "GLState.h"
+#include "MipChain.h"
+#include "Texture.h"
+
+
+// Packs loaded Textures into GL_TEXTURE_2D_ARRAYs, one array per format and size.
+// Draws then only rebind when they move to another array, the layer
+// and uvScale go to the shaders through the texLayer attribute
+class TextureArrays {
+
+private:
+
+    struct Array {
+        unsigned int id{};
+        MipFormat format;
+        uint32_t width;
+        uint32_t height;
+        std::vector<Texture*> layers;
+    };
+
+    std::vector<Array> arrays;
+
+public:
+
+    // Upload every loaded texture in textures into an array layer, duplicates are only packed once
+    void pack(const std::vector<Texture*>& textures) {
+
+        // Bucket textures by format and size, in first seen order
+        std::map<std::tuple<MipFormat, uint32_t, uint32_t>, int> arrayIndex;
+        std::set<Texture*> seen;
+        std::vector<int> newArrays;
+        for (auto t : textures) {
+            if (!t->loaded() || !seen.insert(t).second) {
+                continue;
+            }
+            auto key = std::make_tuple(t->mipFormat, t->levels[0].width, t->levels[0].height);
+            auto it = arrayIndex.find(key);
+            if (it == arrayIndex.end()) {
+                it = arrayIndex.emplace(key, arrays.size()).first;
+                newArrays.push_back(arrays.size());
+                arrays.push_back({ 0, t->mipFormat, t->levels[0].width, t->levels[0].height, {} });
+            }
+            arrays[it->second].layers.push_back(t);
+        }
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (int i : newArrays) {
+            Array& a = arrays[i];
+
+            // Same size so every texture in the array has the same number of levels
+            size_t levelCount = a.layers[0]->levelCount;
+            GLsizei layerCount = a.layers.size();
+
+            // Generate texture array
+            glGenTextures(1, &a.id);
+            GLState::get().bindTexture(0, GL_TEXTURE_2D_ARRAY, a.id);
+
+            // Setting texture attribs
+
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+
+            // Allocate every level for all layers, then copy each texture's levels into its layer
+            for (size_t l = 0; l < levelCount; l++) {
+                const MipLevel& level = a.layers[0]->levels[l];
+                if (a.format == MipFormat::RGBA8) {
+                    glTexImage3D(GL_TEXTURE_2D_ARRAY, l, GL_RGBA, level.width, level.height, layerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+                }
+                else {
+                    glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, l, mipGLFormat(a.format), level.width, level.height, layerCount, 0, level.size * layerCount, NULL);
+                }
+            }
+
+            for (int layer = 0; layer < layerCount; layer++) {
+                Texture* t = a.layers[layer];
+                for (size_t l = 0; l < levelCount; l++) {
+                    const MipLevel& level = t->levels[l];
+                    const unsigned char* data = t->levelData + level.offset;
+                    if (a.format == MipFormat::RGBA8) {
+                        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, l, 0, 0, layer, level.width, level.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, data);
+                    }
+                    else {
+                        glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, l, 0, 0, layer, level.width, level.height, 1, mipGLFormat(a.format), level.size, data);
+                    }
+                }
+
+                t->id = a.id;
+                t->layer = layer;
+                t->release();
+            }
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        std::cout << "Packed " << seen.size() << " textures into " << newArrays.size() << " texture arrays" << std::endl;
+    }
+
+    // Number of texture arrays
+    int count() const { return arrays.size(); }
+};
+
+
+#endif
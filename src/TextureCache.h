@@ -0,0 +1,118 @@
+#ifndef TEXTURECACHE_
+#define TEXTURECACHE_
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include "MappedFile.h"
+#include "MipChain.h"
+
+
+// Header at the start of a texture cache file. It's followed by the
+// MipLevel table and then every level's pixels or blocks back to back
+struct TextureCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceHash;        // fnv1a of the image it was built from
+    MipFormat format;
+    uint32_t levelCount;
+    float uvScale[2];
+};
+
+constexpr char TEXTURE_CACHE_MAGIC[4] = { 'T', 'E', 'X', 'C' };
+constexpr uint32_t TEXTURE_CACHE_VERSION = 2;
+
+
+// Full mip chain of an image stored next to it, so later runs can skip
+// stbi and glGenerateMipmap and upload every level straight from the mapped file
+class TextureCache {
+
+private:
+    MappedFile file;
+    const TextureCacheHeader* header = nullptr;
+
+public:
+
+    // Path of the cache file for the image at path, compressed and uncompressed chains are kept apart
+    static std::string cachePath(const std::string& path, bool compressed) {
+        return path + (compressed ? ".bc.tex" : ".tex");
+    }
+
+    // Map the cache for the image at path, only valid if it was built from a source with sourceHash
+    TextureCache(const std::string& path, bool compressed, uint64_t sourceHash) : file(cachePath(path, compressed)) {
+
+        if (!file.valid() || file.size() < sizeof(TextureCacheHeader)) {
+            return;
+        }
+
+        const TextureCacheHeader* h = (const TextureCacheHeader*)file.data();
+        if (std::memcmp(h->magic, TEXTURE_CACHE_MAGIC, 4) != 0 || h->version != TEXTURE_CACHE_VERSION || h->sourceHash != sourceHash) {
+            return;
+        }
+
+        // Make sure the file holds every level the table says it does
+        if (h->levelCount == 0 || file.size() < sizeof(TextureCacheHeader) + h->levelCount * sizeof(MipLevel)) {
+            return;
+        }
+        const MipLevel* l = (const MipLevel*)(file.data() + sizeof(TextureCacheHeader));
+        const MipLevel& last = l[h->levelCount - 1];
+        if (file.size() < dataOffset(*h) + last.offset + last.size) {
+            return;
+        }
+
+        header = h;
+    }
+
+    // Check if the cache exists, is up to date, and is complete
+    bool valid() const { return header != nullptr; }
+
+    // Getters for the header, level table, and the mapped level data
+    const TextureCacheHeader& getHeader() const { return *header; }
+
+    const MipLevel* levels() const {
+        return (const MipLevel*)(file.data() + sizeof(TextureCacheHeader));
+    }
+
+    const unsigned char* data() const {
+        return file.data() + dataOffset(*header);
+    }
+
+    static size_t dataOffset(const TextureCacheHeader& h) {
+        return sizeof(TextureCacheHeader) + h.levelCount * sizeof(MipLevel);
+    }
+
+    // Write a cache for the image at path, returns false if the file can't be written
+    static bool write(const std::string& path, uint64_t sourceHash, const MipChain& chain) {
+
+        TextureCacheHeader h{};
+        std::memcpy(h.magic, TEXTURE_CACHE_MAGIC, 4);
+        h.version = TEXTURE_CACHE_VERSION;
+        h.sourceHash = sourceHash;
+        h.format = chain.format;
+        h.levelCount = chain.levels.size();
+        std::memcpy(h.uvScale, chain.uvScale, sizeof(h.uvScale));
+
+        // Write to a temp file first so a half-written cache is never picked up
+        std::string out = cachePath(path, chain.format != MipFormat::RGBA8);
+        std::string tmp = out + ".tmp";
+        {
+            std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+            if (!f) {
+                return false;
+            }
+            f.write((const char*)&h, sizeof(h));
+            f.write((const char*)chain.levels.data(), chain.levels.size() * sizeof(MipLevel));
+            f.write((const char*)chain.data.data(), chain.data.size());
+            if (!f) {
+                return false;
+            }
+        }
+        std::remove(out.c_str());
+        return std::rename(tmp.c_str(), out.c_str()) == 0;
+    }
+};
+
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef THREADPOOL_
+#define THREADPOOL_
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Fixed set of worker threads pulling jobs from a shared queue.
+// Jobs must not touch GL, only the thread that owns the context can
+class ThreadPool {
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+
+    std::mutex mutex;
+    std::condition_variable jobAdded;
+    std::condition_variable jobDone;
+
+    // Jobs queued or running
+    int pending = 0;
+    bool stopping = false;
+
+    void work() {
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobAdded.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (jobs.empty()) {
+                    return;
+                }
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            job();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pending--;
+            }
+            jobDone.notify_all();
+        }
+    }
+
+public:
+
+    // Start threads workers, 0 uses one per hardware thread
+    ThreadPool(int threads = 0) {
+        if (threads <= 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for (int i = 0; i < threads; i++) {
+            workers.emplace_back([this] { work(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        jobAdded.notify_all();
+        for (auto& t : workers) {
+            t.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Queue a job to run on a worker
+    void submit(std::function<void()> job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(std::move(job));
+            pending++;
+        }
+        jobAdded.notify_one();
+    }
+
+    // Block until every submitted job has finished
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        jobDone.wait(lock, [this] { return pending == 0; });
+    }
+
+    // Number of worker threads
+    int size() const { return workers.size(); }
+};
+
+
+#endif
@@ -0,0 +1,196 @@
+#ifndef TRANSFORMSYSTEM_
+#define TRANSFORMSYSTEM_
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Same check as Frustum.h, MSVC doesn't define __SSE__
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define TRANSFORM_SSE
+#include <xmmintrin.h>
+#endif
+
+
+// Scene graph of every Mesh's transform. Each transform has a local matrix relative
+// to its parent, and its world (model) and normal matrices, each kept in its own
+// contiguous array. Setting a local matrix only marks it dirty, update() then
+// recomputes the world matrices of just the dirty subtrees, and the normal
+// matrices of everything that moved 4 at a time
+class TransformSystem {
+
+public:
+
+    // Counts from the last update()
+    struct Stats {
+        int transforms = 0;
+        int dirty = 0;          // set since the update before
+        int updated = 0;        // dirty ones plus their children
+    };
+
+private:
+
+    std::vector<glm::mat4> locals;
+    std::vector<glm::mat4> models;
+    std::vector<glm::mat3> normals;
+
+    // Hierarchy, parents[i] is -1 for roots
+    std::vector<int> parents;
+    std::vector<std::vector<int>> children;
+
+    // Transforms whose local changed since the last update(), dirty[i] is set if i is in dirtyList
+    std::vector<uint8_t> dirty;
+    std::vector<int> dirtyList;
+
+    // Transforms whose world matrix was recomputed in this update()
+    std::vector<int> updated;
+
+    Stats stats;
+
+    // Recompute the world matrix of i and everything under it
+    void propagate(int i) {
+        models[i] = parents[i] < 0 ? locals[i] : models[parents[i]] * locals[i];
+        updated.push_back(i);
+        for (int c : children[i]) {
+            propagate(c);
+        }
+    }
+
+    // Normal matrix (transpose of the inverse of the upper 3x3) of models[idx[0..3]],
+    // with each lane of the SSE registers holding a different transform.
+    // Uses cofactor / determinant instead of a full inverse
+    void normalMatrices(const int* idx) {
+#ifdef TRANSFORM_SSE
+        // a[c][r] holds column c row r of all 4 models
+        __m128 a[3][3];
+        for (int c = 0; c < 3; c++) {
+            for (int r = 0; r < 3; r++) {
+                a[c][r] = _mm_setr_ps(models[idx[0]][c][r], models[idx[1]][c][r], models[idx[2]][c][r], models[idx[3]][c][r]);
+            }
+        }
+        auto mul = [](__m128 x, __m128 y) { return _mm_mul_ps(x, y); };
+        auto sub = [](__m128 x, __m128 y) { return _mm_sub_ps(x, y); };
+
+        // Cofactors, cof[c][r] lines up with a[c][r]. For a 3x3 the cyclic
+        // neighbours of a row and column give the cofactor with its sign built in
+        __m128 cof[3][3];
+        for (int c = 0; c < 3; c++) {
+            int c1 = (c + 1) % 3, c2 = (c + 2) % 3;
+            for (int r = 0; r < 3; r++) {
+                int r1 = (r + 1) % 3, r2 = (r + 2) % 3;
+                cof[c][r] = sub(mul(a[c1][r1], a[c2][r2]), mul(a[c2][r1], a[c1][r2]));
+            }
+        }
+
+        // Determinant, expanded along row 0
+        __m128 det = _mm_add_ps(_mm_add_ps(mul(a[0][0], cof[0][0]), mul(a[1][0], cof[1][0])), mul(a[2][0], cof[2][0]));
+        __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+        alignas(16) float lanes[4];
+        for (int c = 0; c < 3; c++) {
+            for (int r = 0; r < 3; r++) {
+                _mm_store_ps(lanes, mul(cof[c][r], invDet));
+                for (int i = 0; i < 4; i++) {
+                    normals[idx[i]][c][r] = lanes[i];
+                }
+            }
+        }
+#else
+        for (int i = 0; i < 4; i++) {
+            normals[idx[i]] = glm::transpose(glm::inverse(glm::mat3(models[idx[i]])));
+        }
+#endif
+    }
+
+public:
+
+    // Add a root transform, returns its index
+    int add(const glm::mat4& local = glm::mat4(1.0f)) {
+        locals.push_back(local);
+        models.push_back(local);
+        normals.push_back(glm::mat3(1.0f));
+        parents.push_back(-1);
+        children.emplace_back();
+        dirty.push_back(0);
+        set(locals.size() - 1, local);
+        return locals.size() - 1;
+    }
+
+    // Set transform i's local matrix, its world and normal matrix (and its children's) are updated on the next update()
+    void set(int i, const glm::mat4& local) {
+        locals[i] = local;
+        if (!dirty[i]) {
+            dirty[i] = 1;
+            dirtyList.push_back(i);
+        }
+    }
+
+    // Make child's local matrix relative to parent, -1 makes it a root again.
+    // parent must not be under child
+    void setParent(int child, int parent) {
+        if (parents[child] >= 0) {
+            std::vector<int>& siblings = children[parents[child]];
+            siblings.erase(std::find(siblings.begin(), siblings.end(), child));
+        }
+        parents[child] = parent;
+        if (parent >= 0) {
+            children[parent].push_back(child);
+        }
+        set(child, locals[child]);
+    }
+
+    // Getters for transform i, world and normal are as of the last update()
+    const glm::mat4& getLocal(int i) const { return locals[i]; }
+    const glm::mat4& getModel(int i) const { return models[i]; }
+    const glm::mat3& getNormal(int i) const { return normals[i]; }
+    int getParent(int i) const { return parents[i]; }
+
+    // Recompute world matrices of every dirty subtree, then their normal matrices. Returns how many moved
+    int update() {
+        updated.clear();
+
+        // Walk down from each dirty transform unless a dirty ancestor's walk will already cover it
+        for (int i : dirtyList) {
+            bool covered = false;
+            for (int p = parents[i]; p >= 0 && !covered; p = parents[p]) {
+                covered = dirty[p];
+            }
+            if (!covered) {
+                propagate(i);
+            }
+        }
+
+        // Batches of 4, the last batch repeats its last transform to fill the lanes
+        for (size_t i = 0; i < updated.size(); i += 4) {
+            int idx[4];
+            for (int j = 0; j < 4; j++) {
+                idx[j] = updated[std::min(i + j, updated.size() - 1)];
+            }
+            normalMatrices(idx);
+        }
+
+        stats.transforms = locals.size();
+        stats.dirty = dirtyList.size();
+        stats.updated = updated.size();
+
+        for (int i : dirtyList) {
+            dirty[i] = 0;
+        }
+        dirtyList.clear();
+        return stats.updated;
+    }
+
+    // Get counts from the last update()
+    const Stats& getStats() const { return stats; }
+};
+
+// toString for TransformSystem::Stats
+std::ostream& operator<<(std::ostream& os, const TransformSystem::Stats& s) {
+    os << "Transforms: " << s.transforms << ", Dirty: " << s.dirty << ", Updated: " << s.updated;
+    return os;
+}
+
+
+#endif
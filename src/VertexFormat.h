@@ -0,0 +1,127 @@
+#ifndef VERTEXFORMAT_
+#define VERTEXFORMAT_
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+
+// Layout of a Geometry's vbo
+//   Float:   position 3 x float, uv 2 x float, normal 3 x float (32 bytes)
+//   Compact: position 4 x normalized short, uv 2 x half, normal GL_INT_2_10_10_10_REV (16 bytes)
+//            with 16 bit indices when the model has fewer than 65536 verticies
+enum class VertexFormat {
+    Float,
+    Compact
+};
+
+// One vertex in the Compact layout
+struct CompactVertex {
+    GLshort pos[4];     // Position in the bounding box mapped to [-1, 1], 4th is padding
+    GLhalf uv[2];       // UV as half floats, keeps UVs outside [0, 1] for repeating textures
+    GLuint normal;      // Normal packed as signed 10:10:10:2
+};
+
+static_assert(sizeof(CompactVertex) == 16, "CompactVertex must be 16 bytes");
+
+
+// Convert a float to a half float, rounding to nearest
+inline GLhalf toHalf(float f) {
+    uint32_t x;
+    std::memcpy(&x, &f, sizeof(x));
+
+    uint32_t sign = (x >> 16) & 0x8000;
+    int32_t exp = (int32_t)((x >> 23) & 0xFF) - 127 + 15;
+    uint32_t mant = x & 0x7FFFFF;
+
+    // NaN and inf
+    if (((x >> 23) & 0xFF) == 0xFF) {
+        return (GLhalf)(sign | 0x7C00 | (mant ? 0x200 : 0));
+    }
+    // Too big, clamp to inf
+    if (exp >= 31) {
+        return (GLhalf)(sign | 0x7C00);
+    }
+    // Too small for a normal half, make a denormal or 0
+    if (exp <= 0) {
+        if (exp < -10) {
+            return (GLhalf)sign;
+        }
+        mant |= 0x800000;
+        uint32_t shift = 14 - exp;
+        uint32_t half = mant >> shift;
+        if ((mant >> (shift - 1)) & 1) {
+            half++;
+        }
+        return (GLhalf)(sign | half);
+    }
+
+    uint32_t half = sign | ((uint32_t)exp << 10) | (mant >> 13);
+    // Round, a carry into the exponent is still correct
+    if (mant & 0x1000) {
+        half++;
+    }
+    return (GLhalf)half;
+}
+
+// Map v in [-1, 1] to a normalized signed short
+inline GLshort toSnorm16(float v) {
+    return (GLshort)std::lround(std::max(-1.0f, std::min(1.0f, v)) * 32767.0f);
+}
+
+// Pack a unit normal into GL_INT_2_10_10_10_REV, x in the low bits
+inline GLuint packNormal(float x, float y, float z) {
+    auto snorm10 = [](float v) {
+        return (GLuint)((int32_t)std::lround(std::max(-1.0f, std::min(1.0f, v)) * 511.0f) & 0x3FF);
+    };
+    return snorm10(x) | (snorm10(y) << 10) | (snorm10(z) << 20);
+}
+
+// Center and half size of the box Compact positions are quantized in
+inline void quantizationBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax, glm::vec3& center, glm::vec3& halfExtent) {
+    center = (boundsMin + boundsMax) * 0.5f;
+    halfExtent = (boundsMax - boundsMin) * 0.5f;
+
+    // Flat axes would divide by 0 when quantizing, any scale works for them
+    for (int i = 0; i < 3; i++) {
+        if (halfExtent[i] <= 0.0f) halfExtent[i] = 1.0f;
+    }
+}
+
+// Matrix that takes Compact positions in [-1, 1] back to model space
+inline glm::mat4 dequantizeMatrix(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    glm::vec3 center, halfExtent;
+    quantizationBox(boundsMin, boundsMax, center, halfExtent);
+    return glm::scale(glm::translate(glm::mat4(1.0f), center), halfExtent);
+}
+
+// Convert verticies in the 8 float layout to the Compact layout
+inline std::vector<CompactVertex> compactVerticies(const GLfloat* verticies, size_t vertexCount,
+                                                   const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    glm::vec3 center, halfExtent;
+    quantizationBox(boundsMin, boundsMax, center, halfExtent);
+
+    std::vector<CompactVertex> out(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++) {
+        const GLfloat* v = verticies + 8 * i;
+        CompactVertex& c = out[i];
+
+        c.pos[0] = toSnorm16((v[0] - center.x) / halfExtent.x);
+        c.pos[1] = toSnorm16((v[1] - center.y) / halfExtent.y);
+        c.pos[2] = toSnorm16((v[2] - center.z) / halfExtent.z);
+        c.pos[3] = 0;
+
+        c.uv[0] = toHalf(v[3]);
+        c.uv[1] = toHalf(v[4]);
+
+        c.normal = packNormal(v[5], v[6], v[7]);
+    }
+    return out;
+}
+
+
+#endif
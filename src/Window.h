@@ -4,6 +4,7 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
+#include "Headless.h"
 
 
 // Callback to adjust Viewport size on framebuffer change
@@ -27,12 +28,51 @@ class Window {
 private:
     int width;
     int height;
-    GLFWwindow* window;
+    GLFWwindow* window = nullptr;
     bool paused = false;
 
+    // Offscreen context and framebuffer, only used in headless mode
+    bool headless;
+    HeadlessContext headlessContext;
+
+    // Set up an EGL context and framebuffer instead of a GLFW window
+    void createHeadless() {
+        if (!headlessContext.createContext()) {
+            exit(-2);
+        }
+
+        // Initialize GLEW, there's no GLX display without a window
+        // but everything needed from the context is still loaded
+        glewExperimental = GL_TRUE;
+        GLenum err = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+        if (err == GLEW_ERROR_NO_GLX_DISPLAY) {
+            err = GLEW_OK;
+        }
+#endif
+        if (err != GLEW_OK) {
+            std::cout << "Cannot Initialize GLEW; terminating..." << std::endl;
+            exit(-3);
+        }
+
+        if (!headlessContext.createFramebuffer(width, height)) {
+            exit(-2);
+        }
+
+        // Same state as a windowed context
+        glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
+        glEnable(GL_DEPTH_TEST);
+    }
+
 public:
 
-	Window(int w, int h): width(w), height(h){  
+    // Open a width x height window, or render offscreen at that size if headless
+	Window(int w, int h, bool headless = false): width(w), height(h), headless(headless) {  
+
+        if (headless) {
+            createHeadless();
+            return;
+        }
          
         // If glfw doesn't initialize, exit
         if (!glfwInit()) {
@@ -84,9 +124,25 @@ public:
         }
 	}
 
-    // Getter for GLFWwindow* window
+    // Getter for GLFWwindow* window, nullptr when headless
     GLFWwindow* getWindow() { return this->window; }
 
+    // Check if rendering offscreen with no window
+    bool isHeadless() { return headless; }
+
+    // Framebuffer the frame ends up in, 0 (the window) unless headless
+    GLuint getFramebuffer() { return headless ? headlessContext.getFramebuffer() : 0; }
+
+    // Size in pixels of the framebuffer the frame ends up in, can differ from the window's size on high DPI screens
+    void getFramebufferSize(int& fbWidth, int& fbHeight) {
+        if (headless) {
+            fbWidth = width;
+            fbHeight = height;
+            return;
+        }
+        glfwGetFramebufferSize(window, &fbWidth, &fbHeight);
+    }
+
     //Getters and setters for width and height
     int getWidth(){ return width; }
     int getHeight() { return height; }
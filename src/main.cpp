@@ -6,16 +6,37 @@
 #include <stdio.h>
 #include <vector>
 #include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/string_cast.hpp>
+#include "AssetLoader.h"
 #include "Texture.h"
+#include "TextureArrays.h"
+#include "Headless.h"
 #include "Window.h"
 #include "Camera.h"
 #include "Mesh.h"
 #include "LightMesh.h"
 #include "ClockMesh.h"
+#include "AnimationSystem.h"
+#include "FrameUniforms.h"
+#include "InstanceGroup.h"
+#include "RenderQueue.h"
+#include "TransformSystem.h"
+#include "SceneBVH.h"
+#include "Frustum.h"
+#include "Profiler.h"
+#include "GLState.h"
+#include "DeferredRenderer.h"
+#include "LightClusters.h"
+#include "ShadowMaps.h"
+#include "FragmentCounter.h"
+#include "FrameTiming.h"
+#include "JobSystem.h"
 
 
 // Name: Joshua Gehl
@@ -25,6 +46,16 @@
 // Width, height
 constexpr GLint WIDTH = 1600, HEIGHT = 900;
 
+// Simulation steps per second, and how fast the rgbLight cycles in radians per second
+constexpr double SIM_RATE = 60.0;
+constexpr double RGB_LIGHT_RATE = 0.3 * 3.14159265358979;
+
+// Integer from environment variable name, or fallback if it isn't set
+int envInt(const char* name, int fallback) {
+    const char* v = std::getenv(name);
+    return v ? std::atoi(v) : fallback;
+}
+
 // Paths to .obj files
 std::string boxPath{ "./objects/box.obj" };
 std::string cBoxPath{ "./objects/cBox.obj" };
@@ -43,12 +74,43 @@ std::string clockPath{ "./objects/clock.obj" };
 std::vector<Mesh*> meshes;
 std::vector<LightMesh*> lMeshes;
 
+// Small lights scattered around the room, EXTRA_LIGHTS=n adds n of them (see addExtraLights())
+std::vector<std::unique_ptr<LightMesh>> extraLights;
+
+// Meshes sharing Geometry, Shader, and texture array, each drawn with one instanced call per range
+std::vector<std::unique_ptr<InstanceGroup>> instanceGroups;
+
+// Draws for the current frame, sorted by state before submitting
+RenderQueue renderQueue;
+
+// BVH over every mesh, culls against the camera's frustum each frame
+SceneBVH sceneBVH;
+
+// Worker threads for culling, binning lights, and building the render lists, JOB_THREADS sets how many (one per core besides this one if not set)
+JobSystem jobs{ envInt("JOB_THREADS", 0) };
+
+// Meshes and instance groups handed to each job when building the render lists
+const int DRAW_GRAIN = 4;
+
+// CPU and GPU time of each pass of the frame
+// P prints the rolling averages, T toggles printing them every second, J writes trace.json
+Profiler profiler;
+bool printTimings = false;
+
 // List of Light* to hold Light objects from LightModels
 std::vector<Light*> lSources;
 
+// Headless benchmark settings, see Headless.h (HEADLESS=1 renders offscreen with no window)
+HeadlessConfig headlessConfig = HeadlessConfig::fromEnv();
+
 // Window
-// Width, Height
-Window w{ WIDTH , HEIGHT };
+// Width, Height, Headless
+Window w{ WIDTH , HEIGHT, headlessConfig.enabled };
+
+// Present mode and frame timing, PRESENT_MODE=vsync|uncapped|limited picks the mode to start in,
+// FRAME_LIMIT the frames per second in limited (144 if not set), and V cycles through them
+// Mode, FrameLimit
+FramePacer pacer{ presentModeFromEnv(), envInt("FRAME_LIMIT", 144) };
 
 // Camera
 // Position, Target, Up, FOV, AspectRatio
@@ -59,62 +121,135 @@ Camera c{glm::vec3(0.070476, 4.299999, 3.724034), glm::vec3(0.0f, 0.0, 0.0f), gl
 Shader s{ "./shaders/vertexShader.glsl", "./shaders/fragmentShader.glsl" };
 Shader ls{"./shaders/lsVertexShader.glsl", "./shaders/lsFragmentShader.glsl"};
 
+// Deferred shaders, G-buffer versions of s and ls, then the two lighting passes
+Shader gs{ "./shaders/vertexShader.glsl", "./shaders/gBufferFragmentShader.glsl" };
+Shader gls{ "./shaders/lsVertexShader.glsl", "./shaders/lsGBufferFragmentShader.glsl" };
+Shader dcs{ "./shaders/deferredVertexShader.glsl", "./shaders/deferredCompositeFragmentShader.glsl" };
+Shader dls{ "./shaders/deferredVertexShader.glsl", "./shaders/deferredLightFragmentShader.glsl" };
+
+// Draws shadow casters into the cube shadow maps
+Shader shs{ "./shaders/shadowVertexShader.glsl", "./shaders/shadowFragmentShader.glsl" };
+
+// Depth only program for the mesh pass prepass
+Shader zs{ "./shaders/depthVertexShader.glsl", "./shaders/depthFragmentShader.glsl" };
+
+// Uniform buffer for camera and light cluster data, shared by every program that lights or transforms
+FrameUniforms frameUniforms;
+
+// Bins lights into clusters of the view frustum so each fragment only loops over the lights reaching it
+LightClusters clusters;
+
+// Deferred renderer, F switches between it and forward rendering. The G-buffer starts at the window's size and follows the framebuffer's
+// Width, Height, CompositeShader, LightShader
+DeferredRenderer deferred{ WIDTH, HEIGHT, dcs, dls };
+bool useDeferred = true;
+
+// Cached cube shadow maps for the three main lights, SHADOW_SIZE and SHADOW_BUDGET override the defaults
+// Resolution, FacesRedrawnPerFrame, ShadowShader
+ShadowMaps shadows{ envInt("SHADOW_SIZE", 512), envInt("SHADOW_BUDGET", 6), shs };
+
+// Lay down the mesh pass's depth before shading it, Z toggles it and DEPTH_PREPASS=0 starts with it off
+bool useDepthPrepass = envInt("DEPTH_PREPASS", 1) != 0;
+
+// Fragments shaded in the mesh pass each frame, to see what the prepass saves
+FragmentCounter meshFragments;
+
+// Loads every Texture and Geometry on worker threads, see main()
+AssetLoader assets;
+
+// Texture arrays every Texture is packed into once it's loaded
+TextureArrays textureArrays;
+
 // Texture
-// TexturePath
-Texture cBoxTex{ "./textures/cBox.png" };
-Texture woodTex{ "./textures/tableWood.png" };
-Texture chairTex{ "./textures/chair.png" };
-Texture whiteTex{ "./textures/white.jpg" };
-Texture blackTex{ "./textures/black.png" };
-Texture floorTex{ "./textures/floorTile.jpg" };
-Texture ceilingTex{ "./textures/ceiling.png" };
-Texture shrekTex{ "./textures/shrek.png" };
-Texture globeTex{"./textures/globe.png"};
-Texture mugTex{ "./textures/mug.png" };
-Texture phoneTex{ "./textures/phone.png" };
-Texture brickTex{ "./textures/brick.jpeg" };
-Texture clockTex{ "./textures/clock.png" };
+// Loader, TexturePath, Format
+// Large textures use TextureFormat::Compressed (BC1/BC3)
+Texture cBoxTex{ assets, "./textures/cBox.png" };
+Texture woodTex{ assets, "./textures/tableWood.png" };
+Texture chairTex{ assets, "./textures/chair.png" };
+Texture whiteTex{ assets, "./textures/white.jpg" };
+Texture blackTex{ assets, "./textures/black.png" };
+Texture floorTex{ assets, "./textures/floorTile.jpg", TextureFormat::Compressed };
+Texture ceilingTex{ assets, "./textures/ceiling.png" };
+Texture shrekTex{ assets, "./textures/shrek.png", TextureFormat::Compressed };
+Texture globeTex{ assets, "./textures/globe.png", TextureFormat::Compressed };
+Texture mugTex{ assets, "./textures/mug.png" };
+Texture phoneTex{ assets, "./textures/phone.png" };
+Texture brickTex{ assets, "./textures/brick.jpeg" };
+Texture clockTex{ assets, "./textures/clock.png" };
+
+// Geometry
+// One vao/vbo/ebo per .obj, shared by every Mesh using that model.
+// Large models use VertexFormat::Compact (16 byte verticies, 16 bit elements)
+GeometryCache geometry{ assets };
+
+// Model and normal matrices for every Mesh, only changed ones are recomputed each frame
+TransformSystem transforms;
+
+// Clock hands and the rgbLight's color, worked out from the simulation time each frame
+AnimationSystem animation{ transforms };
 
 // Mesh
-// Tex, Shader, Camera, OBJPath, LightSources         
+// Tex, Shader, Camera, Transforms, Geometry
 
-Mesh floorMesh{ floorTex, s, c, boxPath, &lSources };
-Mesh ceiling{ ceilingTex, s, c, boxPath, &lSources };
-Mesh walls{ brickTex, s, c, boxPath, &lSources };
+Mesh floorMesh{ floorTex, s, c, transforms, geometry.get(boxPath) };
+Mesh ceiling{ ceilingTex, s, c, transforms, geometry.get(boxPath) };
+Mesh walls{ brickTex, s, c, transforms, geometry.get(boxPath) };
 
-Mesh table{ woodTex, s, c, tablePath, &lSources };
+Mesh table{ woodTex, s, c, transforms, geometry.get(tablePath) };
 
-Mesh chair1{ chairTex, s, c, chairPath, &lSources };
-Mesh chair2{ chairTex, s, c, chairPath, &lSources };
-Mesh chair3{ chairTex, s, c, chairPath, &lSources };
-Mesh chair4{ chairTex, s, c, chairPath, &lSources };
+Mesh chair1{ chairTex, s, c, transforms, geometry.get(chairPath) };
+Mesh chair2{ chairTex, s, c, transforms, geometry.get(chairPath) };
+Mesh chair3{ chairTex, s, c, transforms, geometry.get(chairPath) };
+Mesh chair4{ chairTex, s, c, transforms, geometry.get(chairPath) };
 
-Mesh shrek{ shrekTex, s, c, shrekPath, &lSources};
+Mesh shrek{ shrekTex, s, c, transforms, geometry.get(shrekPath, VertexFormat::Compact)};
 
-Mesh cardboardBox{ cBoxTex, s, c, cBoxPath, &lSources };
+Mesh cardboardBox{ cBoxTex, s, c, transforms, geometry.get(cBoxPath) };
 
-Mesh globe{globeTex, s, c, globePath, &lSources};
+Mesh globe{globeTex, s, c, transforms, geometry.get(globePath, VertexFormat::Compact)};
 
-Mesh mug{ mugTex, s, c, mugPath, &lSources };
+Mesh mug{ mugTex, s, c, transforms, geometry.get(mugPath) };
 
-Mesh secondHand{blackTex, s, c, boxPath, &lSources};
-Mesh minuteHand{ blackTex, s, c, boxPath, &lSources };
-Mesh hourHand{ blackTex, s, c, boxPath, &lSources };
+Mesh secondHand{blackTex, s, c, transforms, geometry.get(boxPath)};
+Mesh minuteHand{ blackTex, s, c, transforms, geometry.get(boxPath) };
+Mesh hourHand{ blackTex, s, c, transforms, geometry.get(boxPath) };
 
 
 // ClockMesh
-// Tex, Shader, Camera, OBJPath, LightSources, Seconds Hand, Minutes Hand, Hours Hand
-ClockMesh clockModel{ clockTex, s, c, clockPath, &lSources, secondHand, minuteHand, hourHand };
+// Tex, Shader, Camera, Transforms, Geometry, Seconds Hand, Minutes Hand, Hours Hand
+ClockMesh clockModel{ clockTex, s, c, transforms, geometry.get(clockPath), secondHand, minuteHand, hourHand };
 
 
 // LightMesh
-// Tex, Shader, lightShader, Camera, OBJPath, LightSources, LightColor, aStr, dStr, sStr, constant, linear, quadratic
-LightMesh ceilingLightMesh{ whiteTex, s, ls, c, clPath, &lSources, glm::vec3(1.0f, 1.0f, 1.0f), 0.25, 1.0, 0.25, 1.0, 0.045, 0.0075 };
-LightMesh phone{ phoneTex, s, ls, c, phonePath, &lSources, glm::vec3(1.0f, 1.0f, 1.0f), 0.05, 1.0, 0.1, 1.0, 0.35, 0.44 };
-LightMesh rgbLight{ whiteTex, s, ls, c, rgbLightPath, &lSources, glm::vec3(1.0f, 1.0f, 1.0f), 0.1, 1.0, 0.7, 1.0, 0.1, 0.05 };
+// Tex, Shader, lightShader, Camera, Transforms, Geometry, LightColor, aStr, dStr, sStr, constant, linear, quadratic
+LightMesh ceilingLightMesh{ whiteTex, s, ls, c, transforms, geometry.get(clPath), glm::vec3(1.0f, 1.0f, 1.0f), 0.25, 1.0, 0.25, 1.0, 0.045, 0.0075 };
+LightMesh phone{ phoneTex, s, ls, c, transforms, geometry.get(phonePath), glm::vec3(1.0f, 1.0f, 1.0f), 0.05, 1.0, 0.1, 1.0, 0.35, 0.44 };
+LightMesh rgbLight{ whiteTex, s, ls, c, transforms, geometry.get(rgbLightPath), glm::vec3(1.0f, 1.0f, 1.0f), 0.1, 1.0, 0.7, 1.0, 0.1, 0.05 };
+
+// Add count small coloured lights spread through the room to lMeshes, for testing lots of lights.
+// They fall off fast (about 4 units) so each only lights a few clusters
+void addExtraLights(int count) {
+    for (int i = 0; i < count; i++) {
+
+        // Low discrepancy spread so any count fills the room evenly
+        float x = std::fmod(i * 0.7548777f, 1.0f);
+        float y = std::fmod(i * 0.5698403f, 1.0f);
+        float z = std::fmod(i * 0.6180340f, 1.0f);
+        glm::vec3 color(std::sin(i * 0.9f) * 0.5f + 0.5f, std::sin(i * 0.9f + 2.0f) * 0.5f + 0.5f, std::sin(i * 0.9f + 4.0f) * 0.5f + 0.5f);
+
+        extraLights.push_back(std::make_unique<LightMesh>(whiteTex, s, ls, c, transforms, geometry.get(boxPath), color, 0.0, 1.0, 0.3, 1.0, 4.5, 20.0));
+        LightMesh& lm = *extraLights.back();
+        lm.translate(glm::vec3(x * 22.0f - 11.0f, y * 11.0f - 1.5f, z * 22.0f - 11.0f));
+        lm.scale(glm::vec3(0.1f, 0.1f, 0.1f));
+        lMeshes.push_back(&lm);
+    }
+}
 
 int main() {
 
+    // Decode every queued Texture and Geometry in parallel and upload them here
+    assets.loadAll();
+
     // Add Mesh ptrs to meshes vector
     
     meshes.push_back(&floorMesh);
@@ -145,11 +280,40 @@ int main() {
     lMeshes.push_back(&phone);
     lMeshes.push_back(&rgbLight);
 
+    addExtraLights(std::max(0, envInt("EXTRA_LIGHTS", 0)));
+
+    // Pack every texture the scene uses into texture arrays
+    std::vector<Texture*> usedTextures;
+    for (auto m : meshes) {
+        usedTextures.insert(usedTextures.end(), m->getMaterials().begin(), m->getMaterials().end());
+    }
+    for (auto lm : lMeshes) {
+        usedTextures.insert(usedTextures.end(), lm->getMaterials().begin(), lm->getMaterials().end());
+    }
+    textureArrays.pack(usedTextures);
+
+    // Move meshes that share a model, shader, and texture array (chairs, clock hands, boxes) into instance groups
+    instanceGroups = makeInstanceGroups(meshes);
+
     // Add Light from LightMesh to lSources vector
     for (auto lm : lMeshes) {
         lSources.push_back(&(*lm).getLightSource());
     }
 
+    // Point both programs at the shared Frame block
+    frameUniforms.attach(s);
+    frameUniforms.attach(ls);
+    frameUniforms.attach(gs);
+    frameUniforms.attach(gls);
+    frameUniforms.attach(dls);
+    frameUniforms.attach(zs);
+
+    // And the programs that light at the light buffers and shadow maps
+    clusters.attach(s);
+    clusters.attach(dls);
+    shadows.attach(s);
+    shadows.attach(dls);
+
 
     // Transform Meshes to where they need to be
     floorMesh.translate(glm::vec3(0.0f, -2.0f, 0.0f));
@@ -191,7 +355,7 @@ int main() {
     globe.translate(glm::vec3(-0.75f, 2.05f, 0.25f));
 
 
-    // Transform ClockMeshes to where they need to be (this also transforms the clock hands)
+    // Transform ClockMeshes to where they need to be (the clock hands are its children so they follow)
     clockModel.translate(glm::vec3(-12.0f, 5.0f, 0.0f));
     clockModel.rotate(90.0f, glm::vec3(0.0f, 1.0f, 0.0f));
 
@@ -209,44 +373,211 @@ int main() {
     rgbLight.translate(glm::vec3(12.2f, 5.0f, 0.0f));
     rgbLight.scale(glm::vec3(0.75f, 0.75f, 0.75f));
 
-    // Angle passed to LightMesh.cycleColor() function
-    float rgbLightAngle = 0.0f;
+    // Animate the clock hands from the wall clock, or sim time headless so every run draws the same frames,
+    // and cycle the rgbLight's color on sim time
+    clockModel.animate(animation, w.isHeadless() ? AnimationClock::Sim : AnimationClock::Wall);
+    animation.addColorCycle(rgbLight, RGB_LIGHT_RATE, glm::vec3(0.0f, 2.0f, 4.0f));
+
+    // Work out every mesh's world matrix, then build the BVH over them now that they're in place, grouped ones included
+    transforms.update();
+    std::vector<Mesh*> allMeshes(meshes.begin(), meshes.end());
+    allMeshes.insert(allMeshes.end(), lMeshes.begin(), lMeshes.end());
+    for (auto& g : instanceGroups) {
+        allMeshes.insert(allMeshes.end(), g->getInstances().begin(), g->getInstances().end());
+    }
+    sceneBVH.build(allMeshes);
+
+    // Everything casts shadows from the main lights, drawn into their maps over the first few frames
+    shadows.addLight(ceilingLightMesh);
+    shadows.addLight(phone);
+    shadows.addLight(rgbLight);
+    shadows.setCasters(allMeshes);
+
+    // Opaque draws go nearest first so hidden fragments fail the depth test before they're shaded
+    renderQueue.setFrontToBack(true);
+
+    // Jobs push draws to their own thread's list
+    renderQueue.setThreads(jobs);
 
-    //Initialize the time on the clock to current time
-    clockModel.initTime();
+    // Frame times for the headless report
+    FrameBenchmark benchmark;
 
-    //Window loop
-    while (!glfwWindowShouldClose(w.getWindow())) { 
+    // When the timing summary was last printed
+    double lastTimingPrint = 0.0;
+
+    // The camera moves in steps at SIM_RATE and the rgbLight follows the steps' time however fast frames are drawn, see FrameTiming.h
+    FixedTimestep sim{ SIM_RATE };
+    if (!w.isHeadless()) {
+        pacer.setMode(pacer.getMode());
+    }
+
+    // Start timing frames from here, not from when loading began
+    pacer.tick();
+
+    //Window loop, or a fixed number of frames when headless
+    while (w.isHeadless() ? benchmark.frames() < headlessConfig.frames : !glfwWindowShouldClose(w.getWindow())) { 
+
+        benchmark.beginFrame();
+        profiler.beginFrame();
+        renderQueue.beginFrame();
+        jobs.beginFrame();
+        GLState::get().beginFrame();
 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); 
 
-        // Draw light sources
-        for (auto lm : lMeshes) {
-            (*lm).render();
+        // Size of what's being drawn into, the light clusters and G-buffer follow it
+        int fbWidth, fbHeight;
+        w.getFramebufferSize(fbWidth, fbHeight);
+
+        // Time since the last frame, headless runs take exactly one step a frame so every run draws the same frames
+        double frameTime = pacer.tick();
+        int steps = sim.advance(w.isHeadless() ? sim.getStep() : frameTime);
+
+        {
+            Profiler::Scope scope(profiler, "update");
+
+            // Move the camera once per step so it covers the same ground at any frame rate,
+            // then draw from between the last two steps
+            if (!w.isHeadless()) {
+                for (int i = 0; i < steps; i++) {
+                    c.step(w, (float)sim.getStep());
+                }
+                c.interpolate(sim.alpha());
+            }
+
+            // Pose everything animated for this frame, sim time ones between the last step and the next
+            animation.update(sim.getRenderTime());
+
+            // Propagate anything that moved down the scene graph, the BVH only needs refitting if something did
+            if (transforms.update() > 0) {
+                sceneBVH.refit();
+            }
+
+            // Lights follow their mesh
+            for (auto lm : lMeshes) {
+                (*lm).updateLightPos();
+            }
+
+            // Bin and upload lights, then the camera and cluster grid, once for every draw this frame
+            {
+                Profiler::Scope scope(profiler, "light clusters");
+                clusters.update(c, lSources, fbWidth, fbHeight, jobs);
+            }
+
+            // Redraw the shadow map faces something moved in
+            {
+                Profiler::Scope scope(profiler, "shadows");
+                shadows.update(lSources, w.getFramebuffer());
+            }
+            frameUniforms.update(c, clusters, shadows);
+
+            // Hide every mesh outside the view frustum, lights still light the scene when culled
+            sceneBVH.cull(Frustum(c.getProj() * c.getView()), jobs);
         }
 
-        // Draw Models
-        for (auto m : meshes) {
-            (*m).render();
+        // Deferred draws both passes into the G-buffer with its own shaders, then lights it after
+        if (useDeferred) {
+            deferred.beginGeometry(fbWidth, fbHeight);
+            renderQueue.setOverride(s, gs);
+            renderQueue.setOverride(ls, gls);
         }
 
-        // Cycle the rgbLight
-        rgbLight.cycleColor(rgbLightAngle);
-        rgbLightAngle += 3.0f;
+        // Queue and draw light sources, submitted on their own so the pass can be timed
+        {
+            Profiler::Scope scope(profiler, "light pass");
+            jobs.dispatch(lMeshes.size(), DRAW_GRAIN, [](int begin, int end) {
+                for (int i = begin; i < end; i++) {
+                    (*lMeshes[i]).draw(renderQueue);
+                }
+            });
+            jobs.wait();
+            renderQueue.submit();
+        }
 
-        // Update clock time
-        clockModel.updateTime(); 
+        // Queue and draw Models and instanced Models, instance buffers are uploaded here once every job is done
+        {
+            Profiler::Scope scope(profiler, "mesh pass");
+            jobs.dispatch(meshes.size(), DRAW_GRAIN, [](int begin, int end) {
+                for (int i = begin; i < end; i++) {
+                    (*meshes[i]).draw(renderQueue);
+                }
+            });
+            jobs.dispatch(instanceGroups.size(), 1, [](int begin, int end) {
+                for (int i = begin; i < end; i++) {
+                    (*instanceGroups[i]).build(renderQueue);
+                }
+            });
+            jobs.wait();
+            for (auto& g : instanceGroups) {
+                (*g).upload();
+            }
+            if (useDepthPrepass) {
+                renderQueue.submitDepth(zs);
+            }
+            meshFragments.begin();
+            renderQueue.submit();
+            meshFragments.end();
+        }
 
-        // Swap buffers after drawing to back buffer
-        glfwSwapBuffers(w.getWindow());
+        // Light the G-buffer into the window (or the headless framebuffer)
+        if (useDeferred) {
+            Profiler::Scope scope(profiler, "lighting");
+            renderQueue.clearOverrides();
+            deferred.light(c, lSources, w.getFramebuffer(), fbWidth, fbHeight);
+        }
+
+        // Nothing to swap or poll without a window, just time the frame.
+        // Its draws are the render queue's plus the shadow faces and deferred lighting, which draw on their own
+        if (w.isHeadless()) {
+            int frameDraws = renderQueue.getStats().draws + shadows.getStats().draws;
+            long long frameTriangles = renderQueue.getStats().triangles + shadows.getStats().triangles;
+            if (useDeferred) {
+                frameDraws += deferred.getStats().draws;
+                frameTriangles += deferred.getStats().triangles;
+            }
+            benchmark.endFrame(frameDraws, frameTriangles);
+            continue;
+        }
+
+        // Swap buffers after drawing to back buffer, waiting first if the frame rate is limited
+        {
+            Profiler::Scope scope(profiler, "swap");
+            pacer.wait();
+            glfwSwapBuffers(w.getWindow());
+        }
 
         // Process pending events that occured this loop
         glfwPollEvents();
 
-        // Callback for camera controls
-        c.camera_callback(w); 
+        // Mouse look, every frame since it isn't scaled by time
+        {
+            Profiler::Scope scope(profiler, "camera look");
+            c.look(w);
+        }
 
         glFlush();
+
+        // Rolling timing summary once a second
+        if (printTimings && glfwGetTime() - lastTimingPrint >= 1.0) {
+            std::cout << profiler.getStats() << std::endl;
+            lastTimingPrint = glfwGetTime();
+        }
+    }
+
+    // Write the benchmark report, and the trace if one was asked for
+    if (w.isHeadless()) {
+        if (benchmark.writeReport(headlessConfig.report, WIDTH, HEIGHT)) {
+            std::cout << "Wrote " << benchmark.frames() << " frame benchmark to " << headlessConfig.report << std::endl;
+        }
+        else {
+            std::cout << "Couldn't write benchmark report " << headlessConfig.report << std::endl;
+        }
+        std::cout << profiler.getStats() << std::endl;
+        std::cout << "Mesh pass " << meshFragments.getStats() << std::endl;
+        if (!headlessConfig.trace.empty() && !profiler.writeTrace(headlessConfig.trace)) {
+            std::cout << "Couldn't write trace " << headlessConfig.trace << std::endl;
+        }
+        return 0;
     }
 
     // Destroy window and free memory
@@ -267,6 +598,60 @@ void glfw_key_callback(GLFWwindow* window, int key, int scancode, int action, in
         w.togglePause();
     }
 
+    // Print render queue, fragment, GL bind, culling, light cluster, shadow, animation, and job stats for the last frame, and the rolling pass timings
+    if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+        std::cout << renderQueue.getStats() << std::endl;
+        std::cout << "Mesh pass " << meshFragments.getStats() << std::endl;
+        std::cout << GLState::get().getStats() << std::endl;
+        std::cout << sceneBVH.getStats() << std::endl;
+        std::cout << clusters.getStats() << std::endl;
+        std::cout << shadows.getStats() << std::endl;
+        if (useDeferred) {
+            std::cout << deferred.getStats() << std::endl;
+        }
+        std::cout << transforms.getStats() << std::endl;
+        std::cout << animation.getStats() << std::endl;
+        std::cout << jobs.getStats() << std::endl;
+        std::cout << profiler.getStats() << std::endl;
+    }
+
+    // Toggle printing pass timings every second
+    if (key == GLFW_KEY_T && action == GLFW_PRESS) {
+        printTimings = !printTimings;
+    }
+
+    // Write every pass timing so far as a Chrome trace
+    if (key == GLFW_KEY_J && action == GLFW_PRESS) {
+        if (profiler.writeTrace("trace.json")) {
+            std::cout << "Wrote trace.json" << std::endl;
+        }
+        else {
+            std::cout << "Couldn't write trace.json" << std::endl;
+        }
+    }
+
+    // Toggle the depth prepass before the mesh pass
+    if (key == GLFW_KEY_Z && action == GLFW_PRESS) {
+        useDepthPrepass = !useDepthPrepass;
+        std::cout << "Depth prepass " << (useDepthPrepass ? "on" : "off") << std::endl;
+    }
+
+    // Cycle between vsync, uncapped, and frame limited presenting
+    if (key == GLFW_KEY_V && action == GLFW_PRESS) {
+        pacer.cycleMode();
+        std::cout << "Present mode " << pacer.getMode();
+        if (pacer.getMode() == PresentMode::Limited) {
+            std::cout << " (" << pacer.getLimit() << " fps)";
+        }
+        std::cout << std::endl;
+    }
+
+    // Switch between deferred and forward rendering
+    if (key == GLFW_KEY_F && action == GLFW_PRESS) {
+        useDeferred = !useDeferred;
+        std::cout << (useDeferred ? "Deferred" : "Forward") << " rendering" << std::endl;
+    }
+
     // Toggle Camera Movement
     if (key == GLFW_KEY_ENTER && action == GLFW_PRESS) { 
         c.toggleMovement(); 